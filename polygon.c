@@ -27,6 +27,21 @@ typedef struct {
     int size;
 } Polygon;
 
+// Result of classifyPolygons, strongest relationship first
+typedef enum {
+    INTERSECTING,
+    TOUCHING,
+    ENCLOSED,
+    OUTSIDE
+} Relationship;
+
+const char* relationshipLabel(Relationship relationship) {
+    static const char* const labels[] = {
+        "Intersecting", "Touching", "Disjoint (Enclosed)", "Disjoint (Outside)"
+    };
+    return labels[relationship];
+}
+
 // Utility functions
 bool areEqual(double a, double b) {
     return fabs(a - b) < EPSILON;
@@ -86,14 +101,30 @@ bool segmentIntersection(LineSegment seg1, LineSegment seg2, Point* result) {
     return segmentContains(seg1, *result) && segmentContains(seg2, *result);
 }
 
-// Helper functions for polygon
-LineSegment* getEdges(const Polygon* poly) {
-    LineSegment* edges = malloc(poly->size * sizeof(LineSegment));
-    for (int i = 0; i < poly->size; i++) {
-        edges[i].p1 = poly->vertices[i];
-        edges[i].p2 = poly->vertices[(i + 1) % poly->size];
+// Edge access straight from the vertex buffer, without allocating
+LineSegment getEdge(const Polygon* poly, int i) {
+    LineSegment edge;
+    edge.p1 = poly->vertices[i];
+    edge.p2 = poly->vertices[i + 1 == poly->size ? 0 : i + 1];
+    return edge;
+}
+
+typedef struct {
+    const Polygon* poly;
+    int index;
+} EdgeIterator;
+
+EdgeIterator edgeIterator(const Polygon* poly) {
+    EdgeIterator it = {poly, 0};
+    return it;
+}
+
+bool nextEdge(EdgeIterator* it, LineSegment* edge) {
+    if (it->index >= it->poly->size) {
+        return false;
     }
-    return edges;
+    *edge = getEdge(it->poly, it->index++);
+    return true;
 }
 
 bool areCollinear(LineSegment seg1, LineSegment seg2) {
@@ -118,17 +149,19 @@ bool edgesOverlap(LineSegment seg1, LineSegment seg2) {
 
 bool polygonContains(const Polygon* poly, Point p) {
     int count = 0;
-    for (int i = 0; i < poly->size; i++) {
-        Point v1 = poly->vertices[i];
-        Point v2 = poly->vertices[(i + 1) % poly->size];
-        LineSegment edge = {v1, v2};
+    EdgeIterator it = edgeIterator(poly);
+    LineSegment edge;
+    while (nextEdge(&it, &edge)) {
+        Point v1 = edge.p1;
+        Point v2 = edge.p2;
         
         if (segmentContains(edge, p)) {
             return true;
         }
         
-        if (areEqual(v1.y, v2.y)) continue;
-        if (p.y < fmin(v1.y, v2.y) || p.y > fmax(v1.y, v2.y)) continue;
+        // Half-open in y, so a vertex on the ray is counted once, by exactly one
+        // of its two edges.
+        if ((v1.y > p.y) == (v2.y > p.y)) continue;
         
         double xIntersect = (p.y - v1.y) * (v2.x - v1.x) / (v2.y - v1.y) + v1.x;
         if (areEqual(xIntersect, p.x)) return true;
@@ -138,75 +171,63 @@ bool polygonContains(const Polygon* poly, Point p) {
     return (count % 2 == 1);
 }
 
-char* classifyPolygons(const Polygon* poly1, const Polygon* poly2) {
-    LineSegment* edges1 = getEdges(poly1);
-    LineSegment* edges2 = getEdges(poly2);
+Relationship classifyPolygons(const Polygon* poly1, const Polygon* poly2) {
     bool isTouching = false;
     bool isIntersecting = false;
     
-    for (int i = 0; i < poly1->size; i++) {
-        for (int j = 0; j < poly2->size; j++) {
-            if (segmentContains(edges1[i], poly2->vertices[j])) {
+    EdgeIterator it1 = edgeIterator(poly1);
+    LineSegment edge1;
+    while (nextEdge(&it1, &edge1)) {
+        EdgeIterator it2 = edgeIterator(poly2);
+        LineSegment edge2;
+        while (nextEdge(&it2, &edge2)) {
+            if (segmentContains(edge1, edge2.p1)) {
                 isTouching = true;
             }
             
-            if (areCollinear(edges1[i], edges2[j]) && edgesOverlap(edges1[i], edges2[j])) {
+            if (areCollinear(edge1, edge2) && edgesOverlap(edge1, edge2)) {
                 isTouching = true;
             }
             
             Point intersectionPoint;
-            if (segmentIntersection(edges1[i], edges2[j], &intersectionPoint)) {
-                if (!pointsEqual(intersectionPoint, edges1[i].p1) && 
-                    !pointsEqual(intersectionPoint, edges1[i].p2) && 
-                    !pointsEqual(intersectionPoint, edges2[j].p1) && 
-                    !pointsEqual(intersectionPoint, edges2[j].p2)) {
+            if (segmentIntersection(edge1, edge2, &intersectionPoint)) {
+                if (!pointsEqual(intersectionPoint, edge1.p1) && 
+                    !pointsEqual(intersectionPoint, edge1.p2) && 
+                    !pointsEqual(intersectionPoint, edge2.p1) && 
+                    !pointsEqual(intersectionPoint, edge2.p2)) {
                     isIntersecting = true;
                 }
             }
         }
     }
     
-    for (int i = 0; i < poly2->size; i++) {
+    EdgeIterator it2 = edgeIterator(poly2);
+    LineSegment edge2;
+    while (nextEdge(&it2, &edge2)) {
         for (int j = 0; j < poly1->size; j++) {
-            if (segmentContains(edges2[i], poly1->vertices[j])) {
+            if (segmentContains(edge2, poly1->vertices[j])) {
                 isTouching = true;
             }
         }
     }
     
-    free(edges1);
-    free(edges2);
-    
     if (isIntersecting) {
-        return "Intersecting";
+        return INTERSECTING;
     }
     
     if (isTouching) {
-        return "Touching";
-    }
-    
-    bool thisInsideOther = true;
-    bool otherInsideThis = true;
-    
-    for (int i = 0; i < poly1->size; i++) {
-        if (!polygonContains(poly2, poly1->vertices[i])) {
-            thisInsideOther = false;
-            break;
-        }
+        return TOUCHING;
     }
     
-    for (int i = 0; i < poly2->size; i++) {
-        if (!polygonContains(poly1, poly2->vertices[i])) {
-            otherInsideThis = false;
-            break;
-        }
-    }
+    // The boundaries do not meet, so one vertex of each ring decides enclosure.
+    bool thisInsideOther = poly1->size > 0 && polygonContains(poly2, poly1->vertices[0]);
+    bool otherInsideThis = poly2->size > 0 && polygonContains(poly1, poly2->vertices[0]);
     
     if (thisInsideOther || otherInsideThis) {
-        return "Disjoint (Enclosed)";
+        return ENCLOSED;
     }
     
-    return "Disjoint (Outside)";
+    return OUTSIDE;
 }
 
 void printPolygon(const Polygon* poly) {
@@ -219,6 +240,7 @@ void printPolygon(const Polygon* poly) {
 }
 
 
+#ifndef POLYGON_NO_MAIN
 int main() {
     Point vertices1[] = {
         {4, 4}, {4, -4}, {-4, -4}, {-4, 4}
@@ -233,8 +255,9 @@ int main() {
     printPolygon(&poly1);
     printPolygon(&poly2);
     
-    char* relationship = classifyPolygons(&poly1, &poly2);
-    printf("Relationship: %s\n", relationship);
+    Relationship relationship = classifyPolygons(&poly1, &poly2);
+    printf("Relationship: %s\n", relationshipLabel(relationship));
     
     return 0;
 }
+#endif
@@ -1,24 +1,161 @@
 #include <iostream>
 #include <cmath>
+#include <cassert>
+#include <cfloat>
 #include <utility>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <exception>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <ratio>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define POLYGON_X86_KERNELS 1
+#endif
 
 using namespace std;
 const double EPSILON = 1e-6;
+const std::size_t TILED_THRESHOLD = 32768;
+const std::size_t HIERARCHY_THRESHOLD = 16384;
 
 bool areEqual(double a, double b) {
     return std::abs(a - b) < EPSILON;
 }
 
-class Point {
+// Shewchuk's bound on the rounding error of the floating-point orientation
+// determinant, relative to the magnitude of its two products.
+const double ORIENT_ERROR_BOUND = (3 + 8 * DBL_EPSILON) * DBL_EPSILON / 2;
+
+// The orientation determinant summed without rounding: each of its six products
+// is split into value and error with fma and the twelve terms are accumulated
+// into a nonoverlapping expansion whose largest component carries the sign.
+double orient2dExact(double ax, double ay, double bx, double by, double cx, double cy) {
+    const double factors[6][2] = {{ax, by}, {-ax, cy}, {-ay, bx}, {ay, cx}, {bx, cy}, {-by, cx}};
+    double expansion[12];
+    int length = 0;
+
+    auto grow = [&](double value) {
+        int k = 0;
+        for (int i = 0; i < length; i++) {
+            double sum = value + expansion[i];
+            double virtualPart = sum - value;
+            double error = (value - (sum - virtualPart)) + (expansion[i] - virtualPart);
+            value = sum;
+            if (error != 0) expansion[k++] = error;
+        }
+        expansion[k++] = value;
+        length = k;
+    };
+
+    for (const auto& factor : factors) {
+        double product = factor[0] * factor[1];
+        grow(product);
+        grow(std::fma(factor[0], factor[1], -product));
+    }
+    for (int i = length - 1; i >= 0; i--) {
+        if (expansion[i] != 0) return expansion[i];
+    }
+    return 0;
+}
+
+// Orientation of c relative to the directed line a->b: positive when c lies to
+// the left, negative to the right and zero when the three points are collinear.
+// The sign is always exact. The floating-point determinant is returned when it
+// clears the static error bound, which is nearly always, and the exact
+// expansion decides the rest.
+double orient2d(double ax, double ay, double bx, double by, double cx, double cy) {
+    double detLeft = (ax - cx) * (by - cy);
+    double detRight = (ay - cy) * (bx - cx);
+    double det = detLeft - detRight;
+    double bound = ORIENT_ERROR_BOUND * (std::abs(detLeft) + std::abs(detRight));
+    if (det > bound || -det > bound) {
+        return det;
+    }
+    return orient2dExact(ax, ay, bx, by, cx, cy);
+}
+
+// Predicates for each coordinate type. Floating-point coordinates use the
+// filtered orient2d, with float promoted to double where every product is
+// exact, and keep the EPSILON comparisons for point equality and Line.
+// Integer coordinates are compared exactly in 128-bit arithmetic, which cannot
+// overflow while the coordinates stay below 2^61 in magnitude. Targets without
+// __int128 convert to double, which is exact for 32-bit coordinates, and the
+// filtered orient2d decides the sign; 64-bit coordinates need __int128 there.
+template <typename T, bool Integral = std::is_integral<T>::value>
+struct CoordinateTraits {
+    typedef double Wide;
+
+    static double orientation(T ax, T ay, T bx, T by, T cx, T cy) {
+        return orient2d(ax, ay, bx, by, cx, cy);
+    }
+
+    static bool equal(T a, T b) {
+        return areEqual(a, b);
+    }
+
+    static bool isZero(Wide value) {
+        return areEqual(value, 0);
+    }
+
+    static T fromReal(double value) {
+        return static_cast<T>(value);
+    }
+};
+
+template <typename T>
+struct CoordinateTraits<T, true> {
+#ifdef __SIZEOF_INT128__
+    typedef __int128 Wide;
+
+    static int orientation(T ax, T ay, T bx, T by, T cx, T cy) {
+        Wide det = (Wide(ax) - cx) * (Wide(by) - cy) - (Wide(ay) - cy) * (Wide(bx) - cx);
+        return (det > 0) - (det < 0);
+    }
+#else
+    static_assert(std::numeric_limits<T>::digits <= DBL_MANT_DIG,
+                  "integer coordinates wider than a double mantissa need __int128");
+
+    typedef double Wide;
+
+    static int orientation(T ax, T ay, T bx, T by, T cx, T cy) {
+        double det = orient2d(ax, ay, bx, by, cx, cy);
+        return (det > 0) - (det < 0);
+    }
+#endif
+
+    static bool equal(T a, T b) {
+        return a == b;
+    }
+
+    static bool isZero(Wide value) {
+        return value == 0;
+    }
+
+    static T fromReal(double value) {
+        return static_cast<T>(std::llround(value));
+    }
+};
+
+template <typename T>
+class BasicPoint {
 public:
-    double x, y;
+    T x, y;
 
-    Point(double x = 0, double y = 0) : x(x), y(y) {}
+    BasicPoint(T x = 0, T y = 0) : x(x), y(y) {}
 
-    bool operator==(const Point& other) const {
-        return areEqual(x, other.x) && areEqual(y, other.y);
+    bool operator==(const BasicPoint& other) const {
+        return CoordinateTraits<T>::equal(x, other.x) && CoordinateTraits<T>::equal(y, other.y);
     }
 
     void print() const {
@@ -26,63 +163,104 @@ public:
     }
 };
 
-class Line {
+typedef BasicPoint<double> Point;
+
+double orient2d(const Point& a, const Point& b, const Point& c) {
+    return orient2d(a.x, a.y, b.x, b.y, c.x, c.y);
+}
+
+// Coefficients are kept in the wide type, so integer lines are exact. The
+// intersection point itself is rounded to the coordinate type.
+template <typename T>
+class BasicLine {
 public:
-    double a, b, c;
+    typedef typename CoordinateTraits<T>::Wide Wide;
+
+    Wide a, b, c;
 
-    Line(const Point& p1, const Point& p2) {
-        a = p2.y - p1.y;
-        b = p1.x - p2.x;
-        c = p2.x * p1.y - p1.x * p2.y;
+    BasicLine(const BasicPoint<T>& p1, const BasicPoint<T>& p2) {
+        a = Wide(p2.y) - p1.y;
+        b = Wide(p1.x) - p2.x;
+        c = Wide(p2.x) * p1.y - Wide(p1.x) * p2.y;
     }
 
-    bool contains(const Point& p) const {
-        return areEqual(a * p.x + b * p.y + c, 0);
+    bool contains(const BasicPoint<T>& p) const {
+        return CoordinateTraits<T>::isZero(a * p.x + b * p.y + c);
     }
 
-    bool intersection(const Line& other, Point& result) const {
-        double determinant = a * other.b - other.a * b;
-        if (areEqual(determinant, 0)) {
+    bool intersection(const BasicLine& other, BasicPoint<T>& result) const {
+        Wide determinant = a * other.b - other.a * b;
+        if (CoordinateTraits<T>::isZero(determinant)) {
             return false;
         }
-        result.x = (b * other.c - other.b * c) / determinant;
-        result.y = (other.a * c - a * other.c) / determinant;
+        double d = double(determinant);
+        result.x = CoordinateTraits<T>::fromReal((double(b) * double(other.c) - double(other.b) * double(c)) / d);
+        result.y = CoordinateTraits<T>::fromReal((double(other.a) * double(c) - double(a) * double(other.c)) / d);
         return true;
     }
 
     void print() const {
-        std::cout << a << "x + " << b << "y + " << c << " = 0";
+        std::cout << double(a) << "x + " << double(b) << "y + " << double(c) << " = 0";
     }
 };
 
-class LineSegment {
-public:
-    Point p1, p2;
-
-    LineSegment(const Point& p1, const Point& p2) : p1(p1), p2(p2) {}
+typedef BasicLine<double> Line;
 
-    bool contains(const Point& p) const {
-        Line line(p1, p2);
+template <typename T>
+class BasicLineSegment {
+public:
+    BasicPoint<T> p1, p2;
 
-        if (!line.contains(p)) {
-            return false;
-        }
+    BasicLineSegment(const BasicPoint<T>& p1, const BasicPoint<T>& p2) : p1(p1), p2(p2) {}
 
+    bool contains(const BasicPoint<T>& p) const {
         return (std::min(p1.x, p2.x) <= p.x && p.x <= std::max(p1.x, p2.x)) &&
-               (std::min(p1.y, p2.y) <= p.y && p.y <= std::max(p1.y, p2.y));
+               (std::min(p1.y, p2.y) <= p.y && p.y <= std::max(p1.y, p2.y)) &&
+               side(p1, p2, p) == 0;
     }
 
-    bool intersection(const LineSegment& other, Point& result) const {
-        Line line1(p1, p2);
-        Line line2(other.p1, other.p2);
+    // True if the segments cross at a single point interior to both.
+    bool crosses(const BasicLineSegment& other) const {
+        auto o1 = side(p1, p2, other.p1);
+        auto o2 = side(p1, p2, other.p2);
+        auto o3 = side(other.p1, other.p2, p1);
+        auto o4 = side(other.p1, other.p2, p2);
+        return ((o1 > 0 && o2 < 0) || (o1 < 0 && o2 > 0)) &&
+               ((o3 > 0 && o4 < 0) || (o3 < 0 && o4 > 0));
+    }
 
-        if (!line1.intersection(line2, result)) {
-            return false;
-        }
+    // True if an endpoint of either segment lies on the other, which covers
+    // shared vertices, T-junctions and collinear overlaps.
+    bool touches(const BasicLineSegment& other) const {
+        return contains(other.p1) || contains(other.p2) ||
+               other.contains(p1) || other.contains(p2);
+    }
 
-        if (contains(result) && other.contains(result)) {
+    // A point where the segments meet: the crossing point, or for touching
+    // segments an endpoint that lies on the other one. Whether they meet is
+    // decided exactly; a crossing point is interpolated from the orientations
+    // and may be rounded.
+    bool intersection(const BasicLineSegment& other, BasicPoint<T>& result) const {
+        if (crosses(other)) {
+            double o1 = orient2d(other.p1.x, other.p1.y, other.p2.x, other.p2.y, p1.x, p1.y);
+            double o2 = orient2d(other.p1.x, other.p1.y, other.p2.x, other.p2.y, p2.x, p2.y);
+            double t = o1 / (o1 - o2);
+            result.x = CoordinateTraits<T>::fromReal(p1.x + t * (double(p2.x) - p1.x));
+            result.y = CoordinateTraits<T>::fromReal(p1.y + t * (double(p2.y) - p1.y));
             return true;
         }
+        for (const BasicPoint<T>* p : {&other.p1, &other.p2}) {
+            if (contains(*p)) {
+                result = *p;
+                return true;
+            }
+        }
+        for (const BasicPoint<T>* p : {&p1, &p2}) {
+            if (other.contains(*p)) {
+                result = *p;
+                return true;
+            }
+        }
         return false;
     }
 
@@ -93,157 +271,3760 @@ public:
         p2.print();
         std::cout << "]";
     }
+
+private:
+    static auto side(const BasicPoint<T>& a, const BasicPoint<T>& b, const BasicPoint<T>& c)
+        -> decltype(CoordinateTraits<T>::orientation(a.x, a.y, b.x, b.y, c.x, c.y)) {
+        return CoordinateTraits<T>::orientation(a.x, a.y, b.x, b.y, c.x, c.y);
+    }
 };
 
-class Polygon {
+typedef BasicLineSegment<double> LineSegment;
+
+// Lightweight view of a closed polygon boundary that yields each edge straight
+// from the vertex buffer, so iterating the edges never allocates. Iterators
+// point into the vertex buffer, not the view, so they outlive a temporary view.
+// Edges are built on dereference and returned by value, which makes them input
+// iterators.
+class EdgeView {
 public:
-    std::vector<Point> vertices;
+    class iterator {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef LineSegment value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef void pointer;
+        typedef LineSegment reference;
 
-    Polygon(const std::vector<Point>& vertices) : vertices(vertices) {}
+        iterator(const Point* points, int count, int index)
+            : points(points), count(count), index(index) {}
 
-    std::vector<LineSegment> getEdges() const {
-        std::vector<LineSegment> edges;
-        int n = vertices.size();
-        for (int i = 0; i < n; i++) {
-            edges.emplace_back(vertices[i], vertices[(i + 1) % n]);
+        LineSegment operator*() const {
+            return LineSegment(points[index], points[index + 1 == count ? 0 : index + 1]);
         }
-        return edges;
+
+        iterator& operator++() {
+            index++;
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator previous = *this;
+            index++;
+            return previous;
+        }
+
+        bool operator==(const iterator& other) const {
+            return index == other.index;
+        }
+
+        bool operator!=(const iterator& other) const {
+            return index != other.index;
+        }
+
+    private:
+        const Point* points;
+        int count;
+        int index;
+    };
+
+    explicit EdgeView(const std::vector<Point>& vertices)
+        : points(vertices.data()), count(vertices.size()) {}
+
+    int size() const {
+        return count;
+    }
+
+    LineSegment operator[](int i) const {
+        return LineSegment(points[i], points[i + 1 == count ? 0 : i + 1]);
+    }
+
+    iterator begin() const {
+        return iterator(points, count, 0);
+    }
+
+    iterator end() const {
+        return iterator(points, count, count);
+    }
+
+private:
+    const Point* points;
+    int count;
+};
+
+// Tolerance models for BasicPolygon, chosen at compile time. side returns the
+// orientation sign of c against a->b, with determinants inside the tolerance
+// reported as collinear. Scale is a std::ratio.
+struct ExactTolerance {
+    template <typename T>
+    static int side(T ax, T ay, T bx, T by, T cx, T cy) {
+        auto det = CoordinateTraits<T>::orientation(ax, ay, bx, by, cx, cy);
+        return (det > 0) - (det < 0);
+    }
+};
+
+// The determinant is compared against a fixed epsilon, as the original
+// EPSILON tests did.
+template <typename Scale = std::micro>
+struct AbsoluteTolerance {
+    template <typename T>
+    static int side(T ax, T ay, T bx, T by, T cx, T cy) {
+        const double epsilon = double(Scale::num) / Scale::den;
+        double det = (double(ax) - cx) * (double(by) - cy) - (double(ay) - cy) * (double(bx) - cx);
+        return (det > epsilon) - (det < -epsilon);
+    }
+};
+
+// The epsilon scales with the magnitude of the determinant's two products.
+template <typename Scale = std::pico>
+struct RelativeTolerance {
+    template <typename T>
+    static int side(T ax, T ay, T bx, T by, T cx, T cy) {
+        double detLeft = (double(ax) - cx) * (double(by) - cy);
+        double detRight = (double(ay) - cy) * (double(bx) - cx);
+        double det = detLeft - detRight;
+        double bound = double(Scale::num) / Scale::den * (std::abs(detLeft) + std::abs(detRight));
+        return (det > bound) - (det < -bound);
+    }
+};
+
+// Boundary semantics for BasicPolygon. closed decides whether contains counts
+// boundary points as inside; touchingFirst whether classify reports Touching
+// ahead of containment, or classifies touching rings by their interiors.
+struct ClosedBoundary {
+    static constexpr bool closed = true;
+    static constexpr bool touchingFirst = true;
+};
+
+// Under open semantics rings that touch are Intersecting when their interiors
+// meet and Outside when only their boundaries do.
+struct OpenBoundary {
+    static constexpr bool closed = false;
+    static constexpr bool touchingFirst = false;
+};
+
+template <typename T, typename Tolerance = ExactTolerance, typename Boundary = ClosedBoundary>
+class BasicPolygon;
+
+template <>
+class BasicPolygon<double>;
+
+typedef BasicPolygon<double> Polygon;
+
+class PreparedPolygon;
+class ThreadPool;
+
+class BoundingBox {
+public:
+    double minX, minY, maxX, maxY;
+
+    BoundingBox()
+        : minX(HUGE_VAL), minY(HUGE_VAL), maxX(-HUGE_VAL), maxY(-HUGE_VAL) {}
+
+    BoundingBox(double minX, double minY, double maxX, double maxY)
+        : minX(minX), minY(minY), maxX(maxX), maxY(maxY) {}
+
+    explicit BoundingBox(const LineSegment& seg)
+        : minX(std::min(seg.p1.x, seg.p2.x)), minY(std::min(seg.p1.y, seg.p2.y)),
+          maxX(std::max(seg.p1.x, seg.p2.x)), maxY(std::max(seg.p1.y, seg.p2.y)) {}
+
+    explicit BoundingBox(const std::vector<Point>& points) : BoundingBox() {
+        for (const auto& p : points) {
+            expand(p);
+        }
+    }
+
+    void expand(const Point& p) {
+        minX = std::min(minX, p.x);
+        minY = std::min(minY, p.y);
+        maxX = std::max(maxX, p.x);
+        maxY = std::max(maxY, p.y);
     }
 
     bool contains(const Point& p) const {
-        int count = 0;
-        int n = vertices.size();
-        for (int i = 0; i < n; i++) {
-            Point v1 = vertices[i];
-            Point v2 = vertices[(i + 1) % n];
+        return minX <= p.x && p.x <= maxX && minY <= p.y && p.y <= maxY;
+    }
 
-            LineSegment edge(v1, v2);
-            if (edge.contains(p)) {
-                return true;
-            }
+    bool contains(const BoundingBox& other) const {
+        return minX <= other.minX && other.maxX <= maxX && minY <= other.minY && other.maxY <= maxY;
+    }
+
+    bool intersects(const BoundingBox& other) const {
+        return minX <= other.maxX && other.minX <= maxX &&
+               minY <= other.maxY && other.minY <= maxY;
+    }
+
+    void print() const {
+        std::cout << "Box[";
+        Point(minX, minY).print();
+        std::cout << " - ";
+        Point(maxX, maxY).print();
+        std::cout << "]";
+    }
+};
+
+// Result of classify, in the order the relationships are ranked: a crossing
+// beats touching, which beats either kind of disjointness.
+enum class Relationship : unsigned char { INTERSECTING, TOUCHING, ENCLOSED, OUTSIDE };
+
+const char* relationshipLabel(Relationship relationship) {
+    static const char* const labels[] = {"Intersecting", "Touching", "Disjoint (Enclosed)",
+                                         "Disjoint (Outside)"};
+    return labels[int(relationship)];
+}
+
+// Evidence behind a classify answer. For a crossing, edge and otherEdge are the
+// first crossing pair found and point is where they cross. For touching, either
+// vertex lies on otherEdge or otherVertex lies on edge, and point is that
+// vertex. thisInsideOther gives the direction of containment. Unused indices
+// stay -1.
+struct RelationshipReport {
+    Relationship relationship = Relationship::OUTSIDE;
+    int edge = -1;
+    int otherEdge = -1;
+    int vertex = -1;
+    int otherVertex = -1;
+    Point point;
+    bool thisInsideOther = false;
+};
+
+// Where a point or piece of boundary lies relative to a polygon.
+enum class Location : unsigned char { INTERIOR, BOUNDARY, EXTERIOR };
+
+// DE-9IM matrix: the dimension of the intersection between the interior,
+// boundary and exterior of one polygon (rows) and those of another (columns),
+// as '0', '1' or '2', or 'F' when empty.
+struct IntersectionMatrix {
+    char cells[9];
+
+    IntersectionMatrix() {
+        std::fill(cells, cells + 9, 'F');
+    }
+
+    char& operator()(Location row, Location column) {
+        return cells[3 * int(row) + int(column)];
+    }
 
-            if (areEqual(v1.y, v2.y)) continue;
-            if (p.y < std::min(v1.y, v2.y) || p.y > std::max(v1.y, v2.y)) continue;
+    char operator()(Location row, Location column) const {
+        return cells[3 * int(row) + int(column)];
+    }
 
-            double xIntersect = (p.y - v1.y) * (v2.x - v1.x) / (v2.y - v1.y) + v1.x;
-            if (areEqual(xIntersect, p.x)) return true;
-            if (xIntersect > p.x) count++;
+    // Pattern cells take a dimension, 'F', 'T' for any non-empty dimension or
+    // '*' for anything, as in "T*F**F***" for within.
+    bool matches(const char* pattern) const {
+        for (int i = 0; i < 9; i++) {
+            char want = pattern[i];
+            bool ok = want == '*' || want == cells[i] || (want == 'T' && cells[i] != 'F');
+            if (!ok) return false;
         }
+        return true;
+    }
 
-        return (count % 2 == 1);
+    std::string toString() const {
+        return std::string(cells, 9);
     }
+};
 
-    string classify(const Polygon& other) const {
-        auto edges1 = getEdges();
-        auto edges2 = other.getEdges();
-        
-        bool isTouching = false;
-        
-        for (const auto& edge1 : edges1) {
-            for (const auto& vertex : other.vertices) {
-                if (edge1.contains(vertex)) {
-                    isTouching = true;
-                    break;
-                }
+// Classifies two axis-aligned rectangles the way classify treats them as
+// polygons. Edges cross properly when a vertical edge of one box meets a
+// horizontal edge of the other away from every endpoint. The boxes touch when a
+// vertical or horizontal edge line is shared.
+Relationship classifyAlignedBoxes(const BoundingBox& a, const BoundingBox& b) {
+    auto inside = [](double v, double lo, double hi) { return (lo < v) & (v < hi); };
+
+    bool outside = (a.maxX < b.minX) | (b.maxX < a.minX) | (a.maxY < b.minY) | (b.maxY < a.minY);
+    bool crossing = ((inside(a.minX, b.minX, b.maxX) | inside(a.maxX, b.minX, b.maxX)) &
+                     (inside(b.minY, a.minY, a.maxY) | inside(b.maxY, a.minY, a.maxY))) |
+                    ((inside(b.minX, a.minX, a.maxX) | inside(b.maxX, a.minX, a.maxX)) &
+                     (inside(a.minY, b.minY, b.maxY) | inside(a.maxY, b.minY, b.maxY)));
+    bool touching = (a.minX == b.minX) | (a.minX == b.maxX) | (a.maxX == b.minX) |
+                    (a.maxX == b.maxX) | (a.minY == b.minY) | (a.minY == b.maxY) |
+                    (a.maxY == b.minY) | (a.maxY == b.maxY);
+    bool aInB = (b.minX <= a.minX) & (a.maxX <= b.maxX) & (b.minY <= a.minY) & (a.maxY <= b.maxY);
+    bool bInA = (a.minX <= b.minX) & (b.maxX <= a.maxX) & (a.minY <= b.minY) & (b.maxY <= a.maxY);
+
+    if (outside) return Relationship::OUTSIDE;
+    if (crossing) return Relationship::INTERSECTING;
+    if (touching) return Relationship::TOUCHING;
+    return aInB | bInA ? Relationship::ENCLOSED : Relationship::OUTSIDE;
+}
+
+std::vector<Point> convexHull(std::vector<Point> points) {
+    std::sort(points.begin(), points.end(), [](const Point& p1, const Point& p2) {
+        return p1.x < p2.x || (p1.x == p2.x && p1.y < p2.y);
+    });
+
+    auto cross = [](const Point& o, const Point& a, const Point& b) {
+        return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+    };
+
+    int n = points.size();
+    if (n < 3) {
+        return points;
+    }
+
+    std::vector<Point> hull(2 * n);
+    int k = 0;
+    for (int i = 0; i < n; i++) {
+        while (k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0) k--;
+        hull[k++] = points[i];
+    }
+    for (int i = n - 2, lower = k + 1; i >= 0; i--) {
+        while (k >= lower && cross(hull[k - 2], hull[k - 1], points[i]) <= 0) k--;
+        hull[k++] = points[i];
+    }
+    hull.resize(k - 1);
+    return hull;
+}
+
+// Shoelace area of a ring, positive for counter-clockwise vertex order.
+double signedArea(const std::vector<Point>& ring) {
+    double area = 0;
+    int n = ring.size();
+    for (int i = 0; i < n; i++) {
+        const Point& p = ring[i];
+        const Point& q = ring[(i + 1) % n];
+        area += p.x * q.y - q.x * p.y;
+    }
+    return area / 2;
+}
+
+// Sutherland-Hodgman clipping of subject against the convex ring clip, in either
+// orientation. subject may be concave; the result then carries zero-width
+// bridges along the clip boundary but its area is still the intersection area.
+std::vector<Point> clipConvex(const std::vector<Point>& subject, const std::vector<Point>& clip) {
+    double orientation = signedArea(clip) < 0 ? -1 : 1;
+    std::vector<Point> output = subject, input;
+    int m = clip.size();
+    for (int j = 0; j < m && !output.empty(); j++) {
+        const Point& a = clip[j];
+        const Point& b = clip[(j + 1) % m];
+        auto side = [&](const Point& p) {
+            return ((b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x)) * orientation;
+        };
+
+        input.swap(output);
+        output.clear();
+        Point previous = input.back();
+        double previousSide = side(previous);
+        for (const Point& p : input) {
+            double current = side(p);
+            if ((current > 0 && previousSide < 0) || (current < 0 && previousSide > 0)) {
+                double t = previousSide / (previousSide - current);
+                output.emplace_back(previous.x + t * (p.x - previous.x),
+                                    previous.y + t * (p.y - previous.y));
             }
-        }
-        
-        for (const auto& edge2 : edges2) {
-            for (const auto& vertex : vertices) {
-                if (edge2.contains(vertex)) {
-                    isTouching = true;
-                    break;
-                }
+            if (current >= 0) {
+                output.push_back(p);
             }
+            previous = p;
+            previousSide = current;
         }
-        
-        for (const auto& edge1 : edges1) {
-            for (const auto& edge2 : edges2) {
-                if (areCollinear(edge1, edge2) && edgesOverlap(edge1, edge2)) {
-                    isTouching = true;
-                    break;
-                }
+    }
+    return output;
+}
+
+// The shared region of two polygons: its rings and their total area. Outer rings
+// run counter-clockwise and holes clockwise.
+struct ClipResult {
+    std::vector<std::vector<Point>> rings;
+    double area = 0;
+};
+
+std::vector<Point> counterClockwise(std::vector<Point> ring) {
+    if (signedArea(ring) < 0) {
+        std::reverse(ring.begin(), ring.end());
+    }
+    return ring;
+}
+
+// Rounding slack, in distance units, for separating-axis tests on coordinates of
+// magnitude up to scale. A gap larger than this is a gap in exact arithmetic.
+double separationTolerance(double scale) {
+    return 16 * DBL_EPSILON * scale;
+}
+
+double coordinateScale(const BoundingBox& box) {
+    return std::max({std::abs(box.minX), std::abs(box.maxX), std::abs(box.minY),
+                     std::abs(box.maxY)});
+}
+
+// True if some edge normal of the counter-clockwise ring h1 separates it from the
+// counter-clockwise ring h2 by more than tolerance. Rings are accessed through
+// ring(k) so callers can walk clockwise storage backwards. The support point of
+// h2 rotates with the edge normal, so the scan is linear in the ring sizes.
+template <typename Ring1, typename Ring2>
+bool ringEdgeSeparates(const Ring1& h1, int n, const Ring2& h2, int m, double tolerance) {
+    if (n < 2 || m == 0) {
+        return false;
+    }
+
+    auto depth = [](double nx, double ny, const Point& p) { return nx * p.x + ny * p.y; };
+
+    int support = 0;
+    for (int i = 0; i < n; i++) {
+        Point a = h1(i);
+        Point b = h1(i + 1 == n ? 0 : i + 1);
+        double nx = b.y - a.y;
+        double ny = a.x - b.x;
+
+        if (i == 0) {
+            for (int j = 1; j < m; j++) {
+                if (depth(nx, ny, h2(j)) < depth(nx, ny, h2(support))) support = j;
             }
-        }
-        
-        bool isIntersecting = false;
-        for (const auto& edge1 : edges1) {
-            for (const auto& edge2 : edges2) {
-                Point intersectionPoint;
-                if (edge1.intersection(edge2, intersectionPoint)) {
-                    if (!edge1.p1.operator==(intersectionPoint) && 
-                        !edge1.p2.operator==(intersectionPoint) && 
-                        !edge2.p1.operator==(intersectionPoint) && 
-                        !edge2.p2.operator==(intersectionPoint)) {
-                        isIntersecting = true;
-                        break;
-                    }
-                }
+        } else {
+            for (int steps = 0; steps < m; steps++) {
+                int next = support + 1 == m ? 0 : support + 1;
+                if (depth(nx, ny, h2(next)) > depth(nx, ny, h2(support))) break;
+                support = next;
             }
         }
-        
-        if (isIntersecting) {
-            return "Intersecting";
-        }
-        
-        if (isTouching) {
-            return "Touching";
+
+        double gap = depth(nx, ny, h2(support)) - depth(nx, ny, a);
+        if (gap > tolerance * std::sqrt(nx * nx + ny * ny)) {
+            return true;
         }
-        
-        bool thisInsideOther = true;
-        bool otherInsideThis = true;
-        
-        for (const auto& vertex : vertices) {
-            if (!other.contains(vertex)) {
-                thisInsideOther = false;
-                break;
-            }
+    }
+    return false;
+}
+
+bool hullEdgeSeparates(const std::vector<Point>& h1, const std::vector<Point>& h2,
+                       double tolerance) {
+    return ringEdgeSeparates([&](int k) { return h1[k]; }, h1.size(),
+                             [&](int k) { return h2[k]; }, h2.size(), tolerance);
+}
+
+bool hullsSeparated(const std::vector<Point>& h1, const std::vector<Point>& h2) {
+    BoundingBox extent;
+    for (const auto& p : h1) extent.expand(p);
+    for (const auto& p : h2) extent.expand(p);
+    double tolerance = separationTolerance(coordinateScale(extent));
+    return hullEdgeSeparates(h1, h2, tolerance) || hullEdgeSeparates(h2, h1, tolerance);
+}
+
+// Cheap rejection tests run by classify before any edge pair is examined. Each
+// stage counts the pairs it settled; EXACT_STAGE counts the pairs let through.
+class FilterPipeline {
+public:
+    enum Stage { BOUNDS_STAGE, HULL_STAGE, EXACT_STAGE, STAGE_COUNT };
+
+    bool hullStageEnabled;
+
+    FilterPipeline() : hullStageEnabled(false) {
+        reset();
+    }
+
+    template <typename Shape1, typename Shape2>
+    bool rejects(const Shape1& shape1, const Shape2& shape2) {
+        if (!shape1.bounds().intersects(shape2.bounds())) {
+            counters[BOUNDS_STAGE]++;
+            return true;
         }
-        
-        for (const auto& vertex : other.vertices) {
-            if (!contains(vertex)) {
-                otherInsideThis = false;
-                break;
-            }
+        if (hullStageEnabled && hullsSeparated(shape1.convexHull(), shape2.convexHull())) {
+            counters[HULL_STAGE]++;
+            return true;
         }
-        
-        if (thisInsideOther || otherInsideThis) {
-            return "Disjoint (Enclosed)";
+        counters[EXACT_STAGE]++;
+        return false;
+    }
+
+    unsigned long long hits(Stage stage) const {
+        return counters[stage].load();
+    }
+
+    void reset() {
+        for (auto& counter : counters) {
+            counter = 0;
         }
-        
-        return "Disjoint (Outside)";
     }
 
-    bool areCollinear(const LineSegment& seg1, const LineSegment& seg2) const {
-        Line line1(seg1.p1, seg1.p2);
-        return line1.contains(seg2.p1) && line1.contains(seg2.p2);
+private:
+    std::atomic<unsigned long long> counters[STAGE_COUNT];
+};
+
+FilterPipeline& classifyFilters() {
+    static FilterPipeline pipeline;
+    return pipeline;
+}
+
+// Sweep-and-prune over the bounding boxes of two edge sets. The boxes are
+// sorted by x once, O((n + m) log(n + m)), and each box entering the sweep is
+// compared with every active box of the other set. Edges that overlap in x
+// but not in y are still compared, so the worst case is O(n * m).
+class EdgeSweep {
+public:
+    // Refills the sweep from two edge ranges. Storage from earlier runs is reused,
+    // so a long-lived sweep stops allocating once it has seen its largest input.
+    template <typename RedEdges, typename BlueEdges>
+    void reset(const RedEdges& red, const BlueEdges& blue) {
+        assignBounds(boxes[0], red);
+        assignBounds(boxes[1], blue);
+        buildEvents();
     }
 
-    bool edgesOverlap(const LineSegment& seg1, const LineSegment& seg2) const {
-        auto isBetween = [](double a, double b, double c) {
-            return std::min(a, b) <= c && c <= std::max(a, b);
-        };
+    // Calls visit(redIndex, blueIndex) once for every red/blue pair whose closed
+    // bounding boxes overlap. Stops early and returns false if visit returns false.
+    template <typename Visitor>
+    bool run(Visitor visit) {
+        for (int set = 0; set < 2; set++) {
+            active[set].clear();
+            slot[set].assign(boxes[set].size(), -1);
+        }
 
-        return (isBetween(seg1.p1.x, seg1.p2.x, seg2.p1.x) ||
-                isBetween(seg1.p1.x, seg1.p2.x, seg2.p2.x) ||
-                isBetween(seg2.p1.x, seg2.p2.x, seg1.p1.x) ||
-                isBetween(seg2.p1.x, seg2.p2.x, seg1.p2.x)) &&
-               (isBetween(seg1.p1.y, seg1.p2.y, seg2.p1.y) ||
-                isBetween(seg1.p1.y, seg1.p2.y, seg2.p2.y) ||
-                isBetween(seg2.p1.y, seg2.p2.y, seg1.p1.y) ||
-                isBetween(seg2.p1.y, seg2.p2.y, seg1.p2.y));
+        for (const auto& event : events) {
+            int set = event.set;
+            int other = 1 - set;
+
+            if (!event.insert) {
+                int pos = slot[set][event.index];
+                int last = active[set].back();
+                active[set][pos] = last;
+                slot[set][last] = pos;
+                active[set].pop_back();
+                continue;
+            }
+
+            const BoundingBox& box = boxes[set][event.index];
+            for (int candidate : active[other]) {
+                const BoundingBox& otherBox = boxes[other][candidate];
+                if (box.maxY < otherBox.minY || otherBox.maxY < box.minY) continue;
+
+                bool keepGoing = set == 0 ? visit(event.index, candidate)
+                                          : visit(candidate, event.index);
+                if (!keepGoing) return false;
+            }
+
+            slot[set][event.index] = active[set].size();
+            active[set].push_back(event.index);
+        }
+        return true;
     }
 
-    void print() const {
-        std::cout << "Polygon: ";
-        for (const auto& vertex : vertices) {
-            vertex.print();
-            std::cout << " ";
+private:
+    struct Event {
+        double x;
+        bool insert;
+        int set;
+        int index;
+    };
+
+    std::vector<BoundingBox> boxes[2];
+    std::vector<Event> events;
+    std::vector<int> active[2];
+    std::vector<int> slot[2];
+
+    template <typename Edges>
+    static void assignBounds(std::vector<BoundingBox>& bounds, const Edges& edges) {
+        bounds.clear();
+        for (const auto& edge : edges) {
+            bounds.emplace_back(edge);
         }
-        std::cout << "\n";
     }
-};
 
+    void buildEvents() {
+        events.clear();
+        for (int set = 0; set < 2; set++) {
+            for (int i = 0; i < (int)boxes[set].size(); i++) {
+                events.push_back({boxes[set][i].minX, true, set, i});
+                events.push_back({boxes[set][i].maxX, false, set, i});
+            }
+        }
+
+        // Inserts come before removals at equal x so touching x-ranges still meet.
+        std::sort(events.begin(), events.end(), [](const Event& e1, const Event& e2) {
+            if (e1.x != e2.x) return e1.x < e2.x;
+            return e1.insert && !e2.insert;
+        });
+    }
+};
+
+// Polygon over any coordinate type, with the classify and contains answers of
+// the double version. Predicates go through the Tolerance policy and contains
+// and classify follow the Boundary policy; both are resolved at compile time.
+// Edge pairs are scanned directly; the convex, box, sweep and SIMD paths are
+// specific to the exact double specialization below.
+template <typename T, typename Tolerance, typename Boundary>
+class BasicPolygon {
+public:
+    BasicPolygon(const std::vector<BasicPoint<T>>& vertices)
+        : ring(vertices), minX(0), minY(0), maxX(0), maxY(0) {
+        if (!vertices.empty()) {
+            minX = maxX = vertices[0].x;
+            minY = maxY = vertices[0].y;
+        }
+        for (const auto& vertex : vertices) {
+            minX = std::min(minX, vertex.x);
+            minY = std::min(minY, vertex.y);
+            maxX = std::max(maxX, vertex.x);
+            maxY = std::max(maxY, vertex.y);
+        }
+    }
+
+    const std::vector<BasicPoint<T>>& vertices() const {
+        return ring;
+    }
+
+    BasicLineSegment<T> edge(int i) const {
+        int n = ring.size();
+        return BasicLineSegment<T>(ring[i], ring[i + 1 == n ? 0 : i + 1]);
+    }
+
+    std::vector<BasicLineSegment<T>> getEdges() const {
+        std::vector<BasicLineSegment<T>> edges;
+        for (int i = 0; i < (int)ring.size(); i++) {
+            edges.push_back(edge(i));
+        }
+        return edges;
+    }
+
+    // Boundary points count as inside only for a closed Boundary policy. The
+    // crossing rule is the half-open one of Polygon::contains.
+    bool contains(const BasicPoint<T>& p) const {
+        bool boundary = false;
+        bool odd = crossingParity(p, boundary);
+        return Boundary::closed ? (boundary | odd) : (!boundary & odd);
+    }
+
+    Relationship classify(const BasicPolygon& other) const {
+        if (maxX < other.minX || other.maxX < minX || maxY < other.minY || other.maxY < minY) {
+            return Relationship::OUTSIDE;
+        }
+
+        bool isTouching = false;
+        int n = ring.size();
+        int m = other.ring.size();
+        for (int i = 0; i < n; i++) {
+            const BasicPoint<T>& p1 = ring[i];
+            const BasicPoint<T>& p2 = ring[i + 1 == n ? 0 : i + 1];
+            for (int j = 0; j < m; j++) {
+                const BasicPoint<T>& q1 = other.ring[j];
+                const BasicPoint<T>& q2 = other.ring[j + 1 == m ? 0 : j + 1];
+                int o1 = side(p1, p2, q1);
+                int o2 = side(p1, p2, q2);
+                int o3 = side(q1, q2, p1);
+                int o4 = side(q1, q2, p2);
+                if (o1 * o2 < 0 && o3 * o4 < 0) {
+                    return Relationship::INTERSECTING;
+                }
+                isTouching |= (o1 == 0 && inBox(p1, p2, q1)) | (o2 == 0 && inBox(p1, p2, q2)) |
+                              (o3 == 0 && inBox(q1, q2, p1)) | (o4 == 0 && inBox(q1, q2, p2));
+            }
+        }
+
+        if (isTouching) {
+            if (Boundary::touchingFirst) {
+                return Relationship::TOUCHING;
+            }
+            return interiorsMeet(other) ? Relationship::INTERSECTING : Relationship::OUTSIDE;
+        }
+        return classifyContainment(other, false);
+    }
+
+    // Enclosure is judged from the vertices, with vertices on the other ring's
+    // boundary counted as inside whatever the Boundary policy. Without touching
+    // the boundaries are disjoint and one vertex of each is enough.
+    Relationship classifyContainment(const BasicPolygon& other, bool isTouching = true) const {
+        if (!isTouching) {
+            if ((insideBox(other) && other.containsClosed(ring[0])) ||
+                (other.insideBox(*this) && containsClosed(other.ring[0]))) {
+                return Relationship::ENCLOSED;
+            }
+            return Relationship::OUTSIDE;
+        }
+
+        bool thisInsideOther = true;
+        for (const auto& vertex : ring) {
+            if (!other.containsClosed(vertex)) {
+                thisInsideOther = false;
+                break;
+            }
+        }
+        if (thisInsideOther) {
+            return Relationship::ENCLOSED;
+        }
+
+        for (const auto& vertex : other.ring) {
+            if (!containsClosed(vertex)) {
+                return Relationship::OUTSIDE;
+            }
+        }
+        return Relationship::ENCLOSED;
+    }
+
+    void print() const {
+        std::cout << "Polygon: ";
+        for (const auto& vertex : ring) {
+            vertex.print();
+            std::cout << " ";
+        }
+        std::cout << "\n";
+    }
+
+private:
+    std::vector<BasicPoint<T>> ring;
+    T minX, minY, maxX, maxY;
+
+    static int side(const BasicPoint<T>& a, const BasicPoint<T>& b, const BasicPoint<T>& c) {
+        return Tolerance::side(a.x, a.y, b.x, b.y, c.x, c.y);
+    }
+
+    bool insideBox(const BasicPolygon& other) const {
+        return !ring.empty() && other.minX <= minX && maxX <= other.maxX &&
+               other.minY <= minY && maxY <= other.maxY;
+    }
+
+    static bool inBox(const BasicPoint<T>& a, const BasicPoint<T>& b, const BasicPoint<T>& p) {
+        return std::min(a.x, b.x) <= p.x && p.x <= std::max(a.x, b.x) &&
+               std::min(a.y, b.y) <= p.y && p.y <= std::max(a.y, b.y);
+    }
+
+    bool crossingParity(const BasicPoint<T>& p, bool& boundary) const {
+        int count = 0;
+        int n = ring.size();
+        for (int i = 0; i < n; i++) {
+            const BasicPoint<T>& a = ring[i];
+            const BasicPoint<T>& b = ring[i + 1 == n ? 0 : i + 1];
+
+            int s = side(a, b, p);
+            boundary |= inBox(a, b, p) && s == 0;
+
+            bool spans = (a.y > p.y) != (b.y > p.y);
+            count += spans && (s > 0) == (b.y > a.y);
+        }
+        return count % 2 == 1;
+    }
+
+    bool containsClosed(const BasicPoint<T>& p) const {
+        bool boundary = false;
+        bool odd = crossingParity(p, boundary);
+        return boundary | odd;
+    }
+
+    // Whether the interiors meet, for rings whose boundaries touch but do not
+    // cross. If no boundary piece of either ring runs through the other's
+    // interior, the interiors can only meet where the rings coincide, that is
+    // when every piece of this ring runs along the other's boundary.
+    bool interiorsMeet(const BasicPolygon& other) const {
+        bool coincide = true;
+        bool unused = true;
+        if (piecesEnter(other, coincide) || other.piecesEnter(*this, unused)) {
+            return true;
+        }
+        return coincide && !ring.empty();
+    }
+
+    // Cuts each edge at the vertices of other lying on it. Without crossings a
+    // piece meets other's boundary only at its ends or all along it, so the
+    // midpoint of a piece off the boundary tells whether it runs through
+    // other's interior. Clears alongBoundary if some piece is off the boundary.
+    bool piecesEnter(const BasicPolygon& other, bool& alongBoundary) const {
+        int n = ring.size();
+        std::vector<BasicPoint<T>> cuts;
+        for (int i = 0; i < n; i++) {
+            const BasicPoint<T>& p1 = ring[i];
+            const BasicPoint<T>& p2 = ring[i + 1 == n ? 0 : i + 1];
+            bool alongX = p1.x != p2.x;
+            cuts.assign({p1, p2});
+            for (const auto& q : other.ring) {
+                if (side(p1, p2, q) == 0 && inBox(p1, p2, q)) cuts.push_back(q);
+            }
+            auto before = [&](const BasicPoint<T>& a, const BasicPoint<T>& b) {
+                return alongX ? a.x < b.x : a.y < b.y;
+            };
+            std::sort(cuts.begin(), cuts.end(), before);
+
+            for (int k = 0; k + 1 < (int)cuts.size(); k++) {
+                const BasicPoint<T>& u = cuts[k];
+                const BasicPoint<T>& v = cuts[k + 1];
+                if (alongX ? u.x == v.x : u.y == v.y) continue;
+                if (other.runsAlongBoundary(u, v)) continue;
+                alongBoundary = false;
+                if (other.sampleInside((double(u.x) + v.x) / 2, (double(u.y) + v.y) / 2)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool runsAlongBoundary(const BasicPoint<T>& u, const BasicPoint<T>& v) const {
+        int n = ring.size();
+        for (int i = 0; i < n; i++) {
+            const BasicPoint<T>& a = ring[i];
+            const BasicPoint<T>& b = ring[i + 1 == n ? 0 : i + 1];
+            if (side(a, b, u) == 0 && side(a, b, v) == 0 && inBox(a, b, u) && inBox(a, b, v)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Ray-cast parity of a sample point off the boundary. The sample need not
+    // lie on T's grid, so it is tested in double, which holds float and 32-bit
+    // coordinates exactly.
+    bool sampleInside(double px, double py) const {
+        int count = 0;
+        int n = ring.size();
+        for (int i = 0; i < n; i++) {
+            const BasicPoint<T>& a = ring[i];
+            const BasicPoint<T>& b = ring[i + 1 == n ? 0 : i + 1];
+            double ax = a.x, ay = a.y, bx = b.x, by = b.y;
+            if ((ay > py) == (by > py)) continue;
+            count += (Tolerance::side(ax, ay, bx, by, px, py) > 0) == (by > ay);
+        }
+        return count % 2 == 1;
+    }
+};
+
+// Grid coordinates are exact and half the size of doubles; float rings are
+// classified through the double predicates.
+typedef BasicPolygon<float> FloatPolygon;
+typedef BasicPolygon<std::int32_t> Int32Polygon;
+#ifdef __SIZEOF_INT128__
+typedef BasicPolygon<std::int64_t> Int64Polygon;
+#endif
+
+// Bounding-volume hierarchy over the edges of one ring. Leaves hold runs of
+// consecutive edges and every parent covers a run of consecutive children, so
+// a node always spans a contiguous edge range. Rings are spatially coherent, so
+// building in ring order gives tight boxes without the sort a sweep pays for.
+// Nodes are stored level by level with the root last.
+struct EdgeHierarchy {
+    static constexpr int LEAF_EDGES = 8;
+    static constexpr int FANOUT = 4;
+
+    struct Node {
+        BoundingBox bounds;
+        int first;
+        int count;
+        int child;
+        int children;
+    };
+
+    std::vector<Node> nodes;
+
+    // xs and ys repeat the first vertex at the end, as in Polygon.
+    EdgeHierarchy(const std::vector<double>& xs, const std::vector<double>& ys) {
+        int n = (int)xs.size() - 1;
+        int levelStart = 0;
+        for (int first = 0; first < n; first += LEAF_EDGES) {
+            Node leaf{BoundingBox(), first, std::min(LEAF_EDGES, n - first), 0, 0};
+            for (int k = first; k <= first + leaf.count; k++) {
+                leaf.bounds.expand(Point(xs[k], ys[k]));
+            }
+            nodes.push_back(leaf);
+        }
+
+        while ((int)nodes.size() - levelStart > 1) {
+            int levelEnd = nodes.size();
+            for (int c = levelStart; c < levelEnd; c += FANOUT) {
+                Node parent{BoundingBox(), nodes[c].first, 0, c, std::min(FANOUT, levelEnd - c)};
+                for (int k = c; k < c + parent.children; k++) {
+                    parent.bounds.expand(Point(nodes[k].bounds.minX, nodes[k].bounds.minY));
+                    parent.bounds.expand(Point(nodes[k].bounds.maxX, nodes[k].bounds.maxY));
+                    parent.count += nodes[k].count;
+                }
+                nodes.push_back(parent);
+            }
+            levelStart = levelEnd;
+        }
+    }
+
+    int root() const {
+        return (int)nodes.size() - 1;
+    }
+};
+
+// The double engine, with the structure-of-arrays copy, convexity and box
+// detection that the fast classify paths and batch kernels build on.
+template <>
+class BasicPolygon<double> {
+public:
+    enum BoxKind { NOT_A_BOX, AXIS_ALIGNED_BOX, ORIENTED_BOX };
+
+    BasicPolygon(const std::vector<Point>& vertices) : ring(vertices), box(vertices) {
+        int n = ring.size();
+        xs.resize(n + 1);
+        ys.resize(n + 1);
+        dxs.resize(n);
+        dys.resize(n);
+        for (int i = 0; i < n; i++) {
+            xs[i] = ring[i].x;
+            ys[i] = ring[i].y;
+        }
+        if (n > 0) {
+            xs[n] = xs[0];
+            ys[n] = ys[0];
+        }
+        for (int i = 0; i < n; i++) {
+            dxs[i] = xs[i + 1] - xs[i];
+            dys[i] = ys[i + 1] - ys[i];
+        }
+        detectConvexity();
+        detectBox();
+    }
+
+    // The vertices are fixed at construction, since every query reads the
+    // arrays and flags derived from them.
+    const std::vector<Point>& vertices() const {
+        return ring;
+    }
+
+    const BoundingBox& bounds() const {
+        return box;
+    }
+
+    bool isConvex() const {
+        return convex;
+    }
+
+    BoxKind shape() const {
+        return boxKind;
+    }
+
+    const std::vector<Point>& convexHull() const {
+        auto hull = std::atomic_load(&hullCache);
+        if (!hull) {
+            auto computed = std::make_shared<const std::vector<Point>>(::convexHull(ring));
+            if (std::atomic_compare_exchange_strong(&hullCache, &hull, computed)) {
+                hull = computed;
+            }
+        }
+        return *hull;
+    }
+
+    EdgeView edges() const {
+        return EdgeView(ring);
+    }
+
+    double area() const {
+        double twiceArea = 0;
+        int n = ring.size();
+        for (int i = 0; i < n; i++) {
+            twiceArea += xs[i] * ys[i + 1] - xs[i + 1] * ys[i];
+        }
+        return std::abs(twiceArea) / 2;
+    }
+
+    // Area of the region shared with other. Axis-aligned boxes use their bounds;
+    // otherwise the non-convex side is clipped against the convex one. When
+    // neither is convex, other is clipped against each fan triangle of this
+    // polygon and the pieces are summed with the triangles' orientation signs.
+    double intersectionArea(const Polygon& other) const {
+        if (!box.intersects(other.box)) {
+            return 0;
+        }
+        if (boxKind == AXIS_ALIGNED_BOX && other.boxKind == AXIS_ALIGNED_BOX) {
+            double width = std::min(box.maxX, other.box.maxX) -
+                           std::max(box.minX, other.box.minX);
+            double height = std::min(box.maxY, other.box.maxY) -
+                            std::max(box.minY, other.box.minY);
+            return std::max(0.0, width) * std::max(0.0, height);
+        }
+        if (other.convex) {
+            return std::abs(signedArea(clipConvex(ring, other.ring)));
+        }
+        if (convex) {
+            return std::abs(signedArea(clipConvex(other.ring, ring)));
+        }
+
+        double total = 0;
+        std::vector<Point> triangle(3, ring.empty() ? Point() : ring[0]);
+        for (int i = 1; i + 1 < (int)ring.size(); i++) {
+            triangle[1] = ring[i];
+            triangle[2] = ring[i + 1];
+            double fan = signedArea(triangle);
+            if (fan == 0) continue;
+            double piece = std::abs(signedArea(clipConvex(other.ring, triangle)));
+            total += fan > 0 ? piece : -piece;
+        }
+        return std::abs(total);
+    }
+
+    // Intersection over union of the two areas, 0 when the union is empty.
+    double intersectionOverUnion(const Polygon& other) const {
+        double shared = intersectionArea(other);
+        double combined = area() + other.area() - shared;
+        return combined > 0 ? shared / combined : 0;
+    }
+
+    std::vector<LineSegment> getEdges() const {
+        EdgeView view = edges();
+        return std::vector<LineSegment>(view.begin(), view.end());
+    }
+
+    // Points on the boundary count as inside. The ray to the right of p counts
+    // an edge when one endpoint lies strictly above p and the other on or below
+    // it, so a ray through a vertex is counted once, and the side of the
+    // crossing comes from the exact orientation of p against the edge.
+    bool contains(const Point& p) const {
+        return locate(p) != Location::EXTERIOR;
+    }
+
+    Location locate(const Point& p) const {
+        if (ring.size() >= HIERARCHY_THRESHOLD) {
+            return locateIndexed(p);
+        }
+
+        int count = 0;
+        bool boundary = false;
+        int n = ring.size();
+        for (int i = 0; i < n; i++) {
+            double x1 = xs[i], y1 = ys[i];
+            double x2 = xs[i + 1], y2 = ys[i + 1];
+
+            double side = edgeSide(i, p.x, p.y);
+            bool inBox = std::min(x1, x2) <= p.x && p.x <= std::max(x1, x2) &&
+                         std::min(y1, y2) <= p.y && p.y <= std::max(y1, y2);
+            boundary |= inBox && side == 0;
+
+            bool spans = (y1 > p.y) != (y2 > p.y);
+            count += spans && (side > 0) == (y2 > y1);
+        }
+
+        if (boundary) return Location::BOUNDARY;
+        return count % 2 == 1 ? Location::INTERIOR : Location::EXTERIOR;
+    }
+
+    void containsBatch(const double* xs, const double* ys, std::size_t count,
+                       std::uint64_t* mask) const;
+
+    Relationship classify(const Polygon& other) const {
+        if (classifyFilters().rejects(*this, other)) {
+            return Relationship::OUTSIDE;
+        }
+        return classifyExact(other);
+    }
+
+    // classify, filling report with the witness behind the answer when it is
+    // not null. The witness search only runs when a report is asked for.
+    Relationship classify(const Polygon& other, RelationshipReport* report) const {
+        Relationship relationship = classify(other);
+        if (report) {
+            *report = RelationshipReport();
+            report->relationship = relationship;
+            if (relationship == Relationship::INTERSECTING ||
+                relationship == Relationship::TOUCHING) {
+                findWitness(other, *report);
+            } else if (relationship == Relationship::ENCLOSED) {
+                report->thisInsideOther = insideDisjoint(other);
+            }
+        }
+        return relationship;
+    }
+
+    // DE-9IM matrix of the pair. Disjoint and nested pairs follow from
+    // classifyExact. Otherwise each ring is cut wherever the other boundary
+    // meets it and every piece is located against the other polygon; the nine
+    // cells follow from which locations the pieces of each ring reach.
+    IntersectionMatrix relate(const Polygon& other) const {
+        const Location interior = Location::INTERIOR;
+        const Location boundary = Location::BOUNDARY;
+        const Location exterior = Location::EXTERIOR;
+
+        IntersectionMatrix matrix;
+        matrix(exterior, exterior) = '2';
+        Relationship relationship = box.intersects(other.box) ? classifyExact(other)
+                                                                    : Relationship::OUTSIDE;
+        if (relationship == Relationship::OUTSIDE) {
+            matrix(interior, exterior) = matrix(exterior, interior) = '2';
+            matrix(boundary, exterior) = matrix(exterior, boundary) = '1';
+            return matrix;
+        }
+        if (relationship == Relationship::ENCLOSED) {
+            matrix(interior, interior) = '2';
+            if (insideDisjoint(other)) {
+                matrix(boundary, interior) = '1';
+                matrix(exterior, interior) = '2';
+                matrix(exterior, boundary) = '1';
+            } else {
+                matrix(interior, boundary) = '1';
+                matrix(interior, exterior) = '2';
+                matrix(boundary, exterior) = '1';
+            }
+            return matrix;
+        }
+
+        bool meets = false;
+        bool reaches[2][3] = {};
+        visitBoundaryPieces(other, meets, [&](Location location) {
+            reaches[0][int(location)] = true;
+            return true;
+        });
+        other.visitBoundaryPieces(*this, meets, [&](Location location) {
+            reaches[1][int(location)] = true;
+            return true;
+        });
+        auto reached = [&](int ring, Location location) { return reaches[ring][int(location)]; };
+
+        // A ring lying wholly along the other boundary is the same ring.
+        bool sameRing = !reached(0, interior) && !reached(0, exterior);
+        matrix(interior, interior) = reached(0, interior) || reached(1, interior) || sameRing ? '2' : 'F';
+        matrix(interior, boundary) = reached(1, interior) ? '1' : 'F';
+        matrix(interior, exterior) = reached(0, exterior) ? '2' : 'F';
+        matrix(boundary, interior) = reached(0, interior) ? '1' : 'F';
+        matrix(boundary, boundary) =
+            reached(0, boundary) || reached(1, boundary) ? '1' : (meets ? '0' : 'F');
+        matrix(boundary, exterior) = reached(0, exterior) ? '1' : 'F';
+        matrix(exterior, interior) = reached(1, exterior) ? '2' : 'F';
+        matrix(exterior, boundary) = reached(1, exterior) ? '1' : 'F';
+        return matrix;
+    }
+
+    // Single predicates agreeing with relate. Each takes its answer from
+    // classifyExact where that settles it, and only touching pairs, whose
+    // interiors may or may not overlap, go on to the boundary pieces, stopping
+    // at the first piece that decides.
+    bool intersects(const Polygon& other) const {
+        return box.intersects(other.box) && classifyExact(other) != Relationship::OUTSIDE;
+    }
+
+    bool disjoint(const Polygon& other) const {
+        return !intersects(other);
+    }
+
+    bool within(const Polygon& other) const {
+        if (!other.box.contains(box)) {
+            return false;
+        }
+        switch (classifyExact(other)) {
+        case Relationship::ENCLOSED:
+            return insideDisjoint(other);
+        case Relationship::TOUCHING:
+            break;
+        default:
+            return false;
+        }
+        bool meets = false;
+        return visitBoundaryPieces(other, meets, [](Location location) {
+            return location != Location::EXTERIOR;
+        });
+    }
+
+    bool touches(const Polygon& other) const {
+        if (!box.intersects(other.box) || classifyExact(other) != Relationship::TOUCHING) {
+            return false;
+        }
+        bool meets = false;
+        bool leaves = false;
+        auto outsideInterior = [&](Location location) {
+            leaves |= location == Location::EXTERIOR;
+            return location != Location::INTERIOR;
+        };
+        if (!visitBoundaryPieces(other, meets, outsideInterior) || !leaves) {
+            return false;
+        }
+        return other.visitBoundaryPieces(*this, meets, outsideInterior) && meets;
+    }
+
+    Relationship classifyExact(const Polygon& other) const {
+        Relationship relationship;
+        if (classifyBoundaries(other, relationship)) {
+            return relationship;
+        }
+        return classifyContainment(other);
+    }
+
+    Relationship classify(const PreparedPolygon& other) const;
+
+    ClipResult intersection(const Polygon& other) const;
+
+    bool areCollinear(const LineSegment& seg1, const LineSegment& seg2) const {
+        return !(seg1.p1.x == seg1.p2.x && seg1.p1.y == seg1.p2.y) &&
+               orient2d(seg1.p1, seg1.p2, seg2.p1) == 0 && orient2d(seg1.p1, seg1.p2, seg2.p2) == 0;
+    }
+
+    bool edgesOverlap(const LineSegment& seg1, const LineSegment& seg2) const {
+        auto isBetween = [](double a, double b, double c) {
+            return std::min(a, b) <= c && c <= std::max(a, b);
+        };
+
+        return (isBetween(seg1.p1.x, seg1.p2.x, seg2.p1.x) ||
+                isBetween(seg1.p1.x, seg1.p2.x, seg2.p2.x) ||
+                isBetween(seg2.p1.x, seg2.p2.x, seg1.p1.x) ||
+                isBetween(seg2.p1.x, seg2.p2.x, seg1.p2.x)) &&
+               (isBetween(seg1.p1.y, seg1.p2.y, seg2.p1.y) ||
+                isBetween(seg1.p1.y, seg1.p2.y, seg2.p2.y) ||
+                isBetween(seg2.p1.y, seg2.p2.y, seg1.p1.y) ||
+                isBetween(seg2.p1.y, seg2.p2.y, seg1.p2.y));
+    }
+
+    void print() const {
+        std::cout << "Polygon: ";
+        for (const auto& vertex : ring) {
+            vertex.print();
+            std::cout << " ";
+        }
+        std::cout << "\n";
+    }
+
+private:
+    // The prepared and batch drivers run the edge stages below directly.
+    friend class PreparedPolygon;
+    friend void classifyBoxesBatch(const Polygon& query, const std::vector<Polygon>& boxes,
+                                   Relationship* relations);
+    friend Relationship classifyParallel(const Polygon& polygon, const Polygon& other,
+                                         ThreadPool& pool);
+
+    void scanEdgesTiled(const Polygon& other, bool& crossing, bool& touching) const;
+
+    // locate through the edge hierarchy. Nodes off p's row or left of p are
+    // skipped. A node wholly right of p is a path between its end vertices that
+    // stays right of p, so it crosses the ray an odd number of times exactly when
+    // those two vertices lie on opposite sides of it.
+    Location locateIndexed(const Point& p) const {
+        const EdgeHierarchy& tree = edgeHierarchy();
+        if (tree.nodes.empty()) {
+            return Location::EXTERIOR;
+        }
+
+        int count = 0;
+        bool boundary = false;
+        int stack[64];
+        int depth = 0;
+        stack[depth++] = tree.root();
+        while (depth > 0) {
+            const EdgeHierarchy::Node& node = tree.nodes[stack[--depth]];
+            if (node.bounds.maxX < p.x || node.bounds.maxY < p.y || node.bounds.minY > p.y) {
+                continue;
+            }
+            if (node.bounds.minX > p.x) {
+                count += (ys[node.first] > p.y) != (ys[node.first + node.count] > p.y);
+                continue;
+            }
+            if (node.children > 0) {
+                for (int k = node.child; k < node.child + node.children; k++) {
+                    stack[depth++] = k;
+                }
+                continue;
+            }
+
+            for (int i = node.first; i < node.first + node.count; i++) {
+                double x1 = xs[i], y1 = ys[i];
+                double x2 = xs[i + 1], y2 = ys[i + 1];
+
+                double side = edgeSide(i, p.x, p.y);
+                bool inBox = std::min(x1, x2) <= p.x && p.x <= std::max(x1, x2) &&
+                             std::min(y1, y2) <= p.y && p.y <= std::max(y1, y2);
+                boundary |= inBox && side == 0;
+
+                bool spans = (y1 > p.y) != (y2 > p.y);
+                count += spans && (side > 0) == (y2 > y1);
+            }
+        }
+
+        if (boundary) return Location::BOUNDARY;
+        return count % 2 == 1 ? Location::INTERIOR : Location::EXTERIOR;
+    }
+
+    const EdgeHierarchy& edgeHierarchy() const {
+        auto cached = std::atomic_load(&hierarchyCache);
+        if (!cached) {
+            auto computed = std::make_shared<const EdgeHierarchy>(xs, ys);
+            if (std::atomic_compare_exchange_strong(&hierarchyCache, &cached, computed)) {
+                cached = computed;
+            }
+        }
+        return *cached;
+    }
+
+    // Calls visit(j) for every edge whose box meets window, through the edge
+    // hierarchy. Stops early and returns false if visit returns false.
+    template <typename Visitor>
+    bool visitEdgesIn(const BoundingBox& window, Visitor visit) const {
+        const EdgeHierarchy& tree = edgeHierarchy();
+        if (tree.nodes.empty()) {
+            return true;
+        }
+
+        int stack[64];
+        int depth = 0;
+        stack[depth++] = tree.root();
+        while (depth > 0) {
+            const EdgeHierarchy::Node& node = tree.nodes[stack[--depth]];
+            if (!node.bounds.intersects(window)) continue;
+            if (node.children > 0) {
+                for (int k = node.child; k < node.child + node.children; k++) {
+                    stack[depth++] = k;
+                }
+                continue;
+            }
+            for (int j = node.first; j < node.first + node.count; j++) {
+                if (edgeBox(j).intersects(window) && !visit(j)) return false;
+            }
+        }
+        return true;
+    }
+
+    BoundingBox edgeBox(int i) const {
+        return BoundingBox(std::min(xs[i], xs[i + 1]), std::min(ys[i], ys[i + 1]),
+                           std::max(xs[i], xs[i + 1]), std::max(ys[i], ys[i + 1]));
+    }
+
+    // Dual-tree walk over both edge hierarchies, calling visit(i, j) for every
+    // edge pair in overlapping leaves. The node with more edges is split first.
+    // Stops early and returns false if visit returns false.
+    template <typename Visitor>
+    bool visitEdgePairs(const Polygon& other, Visitor visit) const {
+        if (edgeHierarchy().nodes.empty() || other.edgeHierarchy().nodes.empty()) {
+            return true;
+        }
+        return visitEdgePairs(other, edgeHierarchy().root(), other.edgeHierarchy().root(), visit);
+    }
+
+    // The same walk restricted to the subtrees under node1 and node2.
+    template <typename Visitor>
+    bool visitEdgePairs(const Polygon& other, int node1, int node2, Visitor visit) const {
+        const EdgeHierarchy& tree1 = edgeHierarchy();
+        const EdgeHierarchy& tree2 = other.edgeHierarchy();
+
+        // Each split pushes at most FANOUT pairs and moves one level down one of
+        // the trees, so the stack never holds more than FANOUT times the two
+        // depths together, which stay below 16 each for int-indexed rings.
+        std::pair<int, int> stack[32 * EdgeHierarchy::FANOUT];
+        int depth = 0;
+        stack[depth++] = std::make_pair(node1, node2);
+        while (depth > 0) {
+            int a = stack[depth - 1].first, b = stack[depth - 1].second;
+            depth--;
+            const EdgeHierarchy::Node& node1 = tree1.nodes[a];
+            const EdgeHierarchy::Node& node2 = tree2.nodes[b];
+            if (!node1.bounds.intersects(node2.bounds)) continue;
+
+            if (node1.children == 0 && node2.children == 0) {
+                for (int i = node1.first; i < node1.first + node1.count; i++) {
+                    for (int j = node2.first; j < node2.first + node2.count; j++) {
+                        if (!visit(i, j)) return false;
+                    }
+                }
+            } else if (node2.children == 0 || (node1.children > 0 && node1.count >= node2.count)) {
+                for (int k = node1.child; k < node1.child + node1.children; k++) {
+                    stack[depth++] = std::make_pair(k, b);
+                }
+            } else {
+                for (int k = node2.child; k < node2.child + node2.children; k++) {
+                    stack[depth++] = std::make_pair(a, k);
+                }
+            }
+        }
+        return true;
+    }
+
+    // Cuts each edge of this ring wherever other's boundary meets it and calls
+    // visit(location) for every piece, with BOUNDARY for pieces running along an
+    // edge of other. The edges of other near an edge and the pieces themselves
+    // are both found through other's edge hierarchy. Returns false as soon as
+    // visit does. meets is set when the two boundaries share a point.
+    template <typename Visitor>
+    bool visitBoundaryPieces(const Polygon& other, bool& meets, Visitor visit) const {
+        int n = ring.size();
+        std::vector<double> cuts;
+        std::vector<int> collinear;
+        for (int i = 0; i < n; i++) {
+            if (dxs[i] == 0 && dys[i] == 0) continue;
+            bool alongX = std::abs(dxs[i]) >= std::abs(dys[i]);
+            cuts.assign({0.0, 1.0});
+            collinear.clear();
+
+            other.visitEdgesIn(edgeBox(i), [&](int j) {
+                int k = j + 1;
+                if (edgesCross(i, other, j)) {
+                    double o1 = other.edgeSide(j, xs[i], ys[i]);
+                    double o2 = other.edgeSide(j, xs[i + 1], ys[i + 1]);
+                    cuts.push_back(std::min(1.0, std::max(0.0, o1 / (o1 - o2))));
+                    meets = true;
+                    return true;
+                }
+                if (edgeContains(i, other.xs[j], other.ys[j])) {
+                    cuts.push_back(alongX ? (other.xs[j] - xs[i]) / dxs[i]
+                                          : (other.ys[j] - ys[i]) / dys[i]);
+                    meets = true;
+                }
+                meets |= other.edgeContains(j, xs[i], ys[i]);
+                if ((other.dxs[j] != 0 || other.dys[j] != 0) &&
+                    edgeSide(i, other.xs[j], other.ys[j]) == 0 &&
+                    edgeSide(i, other.xs[k], other.ys[k]) == 0) {
+                    collinear.push_back(j);
+                }
+                return true;
+            });
+
+            std::sort(cuts.begin(), cuts.end());
+            cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+            for (int c = 0; c + 1 < (int)cuts.size(); c++) {
+                double t0 = cuts[c], t1 = cuts[c + 1];
+                double t = (t0 + t1) / 2;
+                double along = alongX ? xs[i] + t * dxs[i] : ys[i] + t * dys[i];
+
+                bool onEdge = false;
+                for (int j : collinear) {
+                    double a = alongX ? other.xs[j] : other.ys[j];
+                    double b = alongX ? other.xs[j + 1] : other.ys[j + 1];
+                    onEdge |= std::min(a, b) <= along && along <= std::max(a, b);
+                }
+
+                // A piece off other's edges can only test as BOUNDARY through
+                // rounding at a tiny piece, so other points of it are tried.
+                Location location = Location::BOUNDARY;
+                if (!onEdge) {
+                    for (double f : {0.5, 0.25, 0.75}) {
+                        t = t0 + f * (t1 - t0);
+                        Point sample(xs[i] + t * dxs[i], ys[i] + t * dys[i]);
+                        location = other.locateIndexed(sample);
+                        if (location != Location::BOUNDARY) break;
+                    }
+                }
+                if (!visit(location)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // classifyExact up to the containment stage. Box and convex pairs are
+    // settled whole; other pairs go through the edge stage suited to their
+    // size. Returns false when the boundaries turn out disjoint, leaving
+    // containment to the caller.
+    bool classifyBoundaries(const Polygon& other, Relationship& relationship) const {
+        if (boxKind == AXIS_ALIGNED_BOX && other.boxKind == AXIS_ALIGNED_BOX) {
+            relationship = classifyAlignedBoxes(box, other.box);
+            return true;
+        }
+        if (boxKind != NOT_A_BOX && other.boxKind != NOT_A_BOX) {
+            relationship = classifyBoxes(other);
+            return true;
+        }
+        if (convex && other.convex) {
+            relationship = classifyConvex(other);
+            return true;
+        }
+
+        bool crossing = false;
+        bool touching = false;
+        if (std::max(ring.size(), other.ring.size()) >= HIERARCHY_THRESHOLD) {
+            scanEdgesHierarchy(other, crossing, touching);
+        } else if (ring.size() * other.ring.size() >= TILED_THRESHOLD) {
+            scanEdgesChains(other, crossing, touching);
+        } else {
+            scanEdgesTiled(other, crossing, touching);
+        }
+        if (crossing || touching) {
+            relationship = crossing ? Relationship::INTERSECTING : Relationship::TOUCHING;
+            return true;
+        }
+        return false;
+    }
+
+    // Convex pairs: a linear separating-axis scan rejects separated pairs, the
+    // boundaries are compared by merging their x-monotone upper and lower chains,
+    // which visits O(n + m) edge pairs, and containment uses O(log n) wedge tests.
+    Relationship classifyConvex(const Polygon& other) const {
+        int n = ring.size();
+        int m = other.ring.size();
+
+        double tolerance = separationTolerance(
+            std::max(coordinateScale(box), coordinateScale(other.box)));
+        auto ring1 = [&](int k) { return ring[ccwIndex(k)]; };
+        auto ring2 = [&](int k) { return other.ring[other.ccwIndex(k)]; };
+        if (ringEdgeSeparates(ring1, n, ring2, m, tolerance) ||
+            ringEdgeSeparates(ring2, m, ring1, n, tolerance)) {
+            return Relationship::OUTSIDE;
+        }
+
+        bool isTouching = false;
+        bool isIntersecting = false;
+        for (int c1 = 0; c1 < 2 && !isIntersecting; c1++) {
+            for (int c2 = 0; c2 < 2 && !isIntersecting; c2++) {
+                mergeChains(chain(c1), other, other.chain(c2), [&](int i, int j) {
+                    if (edgesCross(i, other, j)) {
+                        isIntersecting = true;
+                        return false;
+                    }
+                    if (!isTouching) {
+                        isTouching = edgesTouch(i, other, j);
+                    }
+                    return true;
+                });
+            }
+        }
+
+        if (isIntersecting) {
+            return Relationship::INTERSECTING;
+        }
+        if (isTouching) {
+            return Relationship::TOUCHING;
+        }
+
+        if ((other.box.contains(box) && other.convexContains(ring[0])) ||
+            (box.contains(other.box) && convexContains(other.ring[0]))) {
+            return Relationship::ENCLOSED;
+        }
+        return Relationship::OUTSIDE;
+    }
+
+    // Two boxes, at least one of them rotated. Separation is decided on the four
+    // edge normals of each box, then the sixteen edge pairs run the usual crossing
+    // and touching tests, and containment checks four corners against four edges.
+    Relationship classifyBoxes(const Polygon& other) const {
+        double tolerance = separationTolerance(
+            std::max(coordinateScale(box), coordinateScale(other.box)));
+        if (boxSeparates(other, tolerance) || other.boxSeparates(*this, tolerance)) {
+            return Relationship::OUTSIDE;
+        }
+
+        bool touching = false;
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                if (edgesCross(i, other, j)) {
+                    return Relationship::INTERSECTING;
+                }
+                touching |= edgesTouch(i, other, j);
+            }
+        }
+        if (touching) {
+            return Relationship::TOUCHING;
+        }
+        if (boxCornersInside(other) || other.boxCornersInside(*this)) {
+            return Relationship::ENCLOSED;
+        }
+        return Relationship::OUTSIDE;
+    }
+
+    // Point-in-convex-polygon by binary search over the fan from the first vertex.
+    // Points on the boundary count as inside.
+    bool convexContains(const Point& p) const {
+        int n = ring.size();
+        if (n < 3) {
+            return false;
+        }
+
+        const Point& origin = ring[0];
+        double first = orient2d(origin, ring[ccwIndex(1)], p);
+        double last = orient2d(origin, ring[ccwIndex(n - 1)], p);
+        if (first < 0 || last > 0) {
+            return false;
+        }
+
+        // The lines through the edges at the origin support the polygon, so a
+        // point on either of them is inside only if it lies on an edge.
+        if (first == 0 || last == 0) {
+            for (int i = 0; i < n; i++) {
+                if (edgeContains(i, p.x, p.y)) return true;
+            }
+            return false;
+        }
+
+        int low = 1;
+        int high = n - 1;
+        while (high - low > 1) {
+            int mid = (low + high) / 2;
+            if (orient2d(origin, ring[ccwIndex(mid)], p) >= 0) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        return orient2d(ring[ccwIndex(low)], ring[ccwIndex(high)], p) >= 0;
+    }
+
+    // Sweeps the edge pairs for the first crossing, or when report says the rings
+    // only touch, the first vertex lying on an edge. Every vertex starts an edge
+    // whose box meets the edge it lies on, so checking start vertices suffices.
+    void findWitness(const Polygon& other, RelationshipReport& report) const {
+        EdgeView edges1 = edges();
+        EdgeView edges2 = other.edges();
+        bool crossing = report.relationship == Relationship::INTERSECTING;
+
+        EdgeSweep sweep;
+        sweep.reset(edges1, edges2);
+        sweep.run([&](int i, int j) {
+            if (crossing) {
+                if (!edgesCross(i, other, j)) return true;
+                report.edge = i;
+                report.otherEdge = j;
+                double o1 = other.edgeSide(j, xs[i], ys[i]);
+                double o2 = other.edgeSide(j, xs[i + 1], ys[i + 1]);
+                double t = o1 / (o1 - o2);
+                report.point = Point(xs[i] + t * dxs[i], ys[i] + t * dys[i]);
+                return false;
+            }
+            if (edgeContains(i, other.xs[j], other.ys[j])) {
+                report.edge = i;
+                report.otherVertex = j;
+                report.point = other.ring[j];
+                return false;
+            }
+            if (other.edgeContains(j, xs[i], ys[i])) {
+                report.vertex = i;
+                report.otherEdge = j;
+                report.point = ring[i];
+                return false;
+            }
+            return true;
+        });
+    }
+
+    // Large rings: edges are matched through their monotone chains. Each chain
+    // of the ring with fewer chains looks up the overlapping chains of the other
+    // in its cached x-order, and each overlapping pair is cut down to the other's
+    // x-range by binary search and merged in one linear walk.
+    void scanEdgesChains(const Polygon& other, bool& crossing, bool& touching) const {
+        const MonotoneChains& chains1 = monotoneChains();
+        const MonotoneChains& chains2 = other.monotoneChains();
+        auto scanChains = [&](int a, int b) {
+            const BoundingBox& envelope1 = chains1.envelopes[a];
+            const BoundingBox& envelope2 = chains2.envelopes[b];
+            Chain c1 = clipChain(chains1.chains[a], envelope2.minX, envelope2.maxX);
+            Chain c2 = other.clipChain(chains2.chains[b], envelope1.minX, envelope1.maxX);
+            mergeChains(c1, other, c2, [&](int i, int j) {
+                return scanEdgePair(i, other, j, crossing, touching);
+            });
+            return !crossing;
+        };
+
+        int count1 = chains1.chains.size();
+        int count2 = chains2.chains.size();
+        if (count1 >= count2) {
+            for (int b = 0; b < count2 && !crossing; b++) {
+                chains1.visitChainsIn(chains2.envelopes[b], [&](int a) {
+                    return scanChains(a, b);
+                });
+            }
+        } else {
+            for (int a = 0; a < count1 && !crossing; a++) {
+                chains2.visitChainsIn(chains1.envelopes[a], [&](int b) {
+                    return scanChains(a, b);
+                });
+            }
+        }
+    }
+
+    // Huge rings: the cached edge hierarchies are walked together, so neither
+    // side is sorted and only edges in overlapping leaves are compared.
+    // When only one ring is huge, each edge of the small ring instead queries
+    // the huge ring's hierarchy with its box, so a big ring prepared once answers
+    // small candidates in time logarithmic in its size.
+    void scanEdgesHierarchy(const Polygon& other, bool& crossing, bool& touching) const {
+        int n = ring.size();
+        int m = other.ring.size();
+        if (std::min(n, m) >= (int)HIERARCHY_THRESHOLD) {
+            visitEdgePairs(other, [&](int i, int j) {
+                return scanEdgePair(i, other, j, crossing, touching);
+            });
+        } else if (n >= m) {
+            for (int j = 0; j < m && !crossing; j++) {
+                visitEdgesIn(other.edgeBox(j), [&](int i) {
+                    return scanEdgePair(i, other, j, crossing, touching);
+                });
+            }
+        } else {
+            for (int i = 0; i < n && !crossing; i++) {
+                other.visitEdgesIn(edgeBox(i), [&](int j) {
+                    return scanEdgePair(i, other, j, crossing, touching);
+                });
+            }
+        }
+    }
+
+    // Crossing and touching tests for one edge pair, as every edge stage runs
+    // them. Returns false once a crossing is found.
+    bool scanEdgePair(int i, const Polygon& other, int j, bool& crossing, bool& touching) const {
+        if (edgesCross(i, other, j)) {
+            crossing = true;
+            return false;
+        }
+        if (!touching) {
+            touching = edgesTouch(i, other, j);
+        }
+        return true;
+    }
+
+    // Only valid once crossings and touching are ruled out. The boundaries are
+    // then disjoint, so each ring lies wholly inside or wholly outside the other
+    // and a single vertex of each settles it.
+    Relationship classifyContainment(const Polygon& other) const {
+        if (insideDisjoint(other) || other.insideDisjoint(*this)) {
+            return Relationship::ENCLOSED;
+        }
+        return Relationship::OUTSIDE;
+    }
+
+    // Whether this ring lies inside other, given that the boundaries are
+    // disjoint. The box test skips the point query when it cannot succeed.
+    bool insideDisjoint(const Polygon& other) const {
+        return !ring.empty() && other.box.contains(box) && other.contains(ring[0]);
+    }
+
+    // orient2d of (px, py) against edge i, from the arrays.
+    double edgeSide(int i, double px, double py) const {
+        return orient2d(xs[i], ys[i], xs[i + 1], ys[i + 1], px, py);
+    }
+
+    bool edgeContains(int i, double px, double py) const {
+        double x1 = xs[i], y1 = ys[i];
+        double x2 = xs[i + 1], y2 = ys[i + 1];
+        return std::min(x1, x2) <= px && px <= std::max(x1, x2) &&
+               std::min(y1, y2) <= py && py <= std::max(y1, y2) && edgeSide(i, px, py) == 0;
+    }
+
+    // Edge i must have a direction; a zero-length edge touches only through the
+    // vertex-on-edge test.
+    bool edgesCollinearOverlap(int i, const Polygon& other, int j) const {
+        int k = j + 1;
+        return (dxs[i] != 0 || dys[i] != 0) &&
+               std::max(std::min(xs[i], xs[i + 1]), std::min(other.xs[j], other.xs[k])) <=
+                   std::min(std::max(xs[i], xs[i + 1]), std::max(other.xs[j], other.xs[k])) &&
+               std::max(std::min(ys[i], ys[i + 1]), std::min(other.ys[j], other.ys[k])) <=
+                   std::min(std::max(ys[i], ys[i + 1]), std::max(other.ys[j], other.ys[k])) &&
+               edgeSide(i, other.xs[j], other.ys[j]) == 0 &&
+               edgeSide(i, other.xs[k], other.ys[k]) == 0;
+    }
+
+    // Vertex-on-edge and collinear-overlap tests for one edge pair. Every vertex
+    // starts an edge, so checking the start vertices of the pairs an edge stage
+    // visits covers all of them.
+    bool edgesTouch(int i, const Polygon& other, int j) const {
+        return edgeContains(i, other.xs[j], other.ys[j]) || other.edgeContains(j, xs[i], ys[i]) ||
+               edgesCollinearOverlap(i, other, j);
+    }
+
+    // LineSegment::crosses from the arrays. The bounding boxes are compared
+    // first so most far-apart pairs never reach the orientation tests.
+    bool edgesCross(int i, const Polygon& other, int j) const {
+        int k = j + 1;
+        if (std::max(xs[i], xs[i + 1]) < std::min(other.xs[j], other.xs[k]) ||
+            std::max(other.xs[j], other.xs[k]) < std::min(xs[i], xs[i + 1]) ||
+            std::max(ys[i], ys[i + 1]) < std::min(other.ys[j], other.ys[k]) ||
+            std::max(other.ys[j], other.ys[k]) < std::min(ys[i], ys[i + 1])) {
+            return false;
+        }
+        double o1 = edgeSide(i, other.xs[j], other.ys[j]);
+        double o2 = edgeSide(i, other.xs[k], other.ys[k]);
+        double o3 = other.edgeSide(j, xs[i], ys[i]);
+        double o4 = other.edgeSide(j, xs[i + 1], ys[i + 1]);
+        return ((o1 > 0 && o2 < 0) || (o1 < 0 && o2 > 0)) &&
+               ((o3 > 0 && o4 < 0) || (o3 < 0 && o4 > 0));
+    }
+
+    // Index of the k-th vertex when walking the ring counter-clockwise from
+    // vertex 0.
+    int ccwIndex(int k) const {
+        int n = ring.size();
+        return orientation >= 0 || k == 0 ? k : n - k;
+    }
+
+    double minEdgeLength() const {
+        double shortest = HUGE_VAL;
+        for (int i = 0; i < (int)dxs.size(); i++) {
+            shortest = std::min(shortest, std::sqrt(dxs[i] * dxs[i] + dys[i] * dys[i]));
+        }
+        return shortest;
+    }
+
+    // A convex ring splits at its leftmost and rightmost vertices into two chains
+    // along which x never decreases (chain 0) or never increases (chain 1).
+    struct Chain {
+        int first;
+        int count;
+        bool reversed;
+    };
+
+    Chain chain(int which) const {
+        int n = ring.size();
+        int left = std::min_element(xs.begin(), xs.begin() + n) - xs.begin();
+        int right = std::max_element(xs.begin(), xs.begin() + n) - xs.begin();
+        if (which == 0) {
+            return Chain{left, (right - left + n) % n, false};
+        }
+        return Chain{right, (left - right + n) % n, true};
+    }
+
+    // Maximal runs of edges along which neither x nor y changes direction, with
+    // the bounding box of each run. A run's box is the box of its two end
+    // vertices, and its edges come sorted by x.
+    struct MonotoneChains {
+        std::vector<Chain> chains;
+        std::vector<BoundingBox> envelopes;
+
+        // Chain indices in order of envelope minX, and the running maximum of
+        // envelope maxX along that order. The chains left of an x-range form a
+        // prefix of the order that one binary search over reachX skips.
+        std::vector<int> byMinX;
+        std::vector<double> reachX;
+
+        // Calls visit(a) for every chain whose envelope meets window. Stops
+        // early and returns false if visit returns false.
+        template <typename Visitor>
+        bool visitChainsIn(const BoundingBox& window, Visitor visit) const {
+            int k = std::lower_bound(reachX.begin(), reachX.end(), window.minX) - reachX.begin();
+            for (; k < (int)byMinX.size() && envelopes[byMinX[k]].minX <= window.maxX; k++) {
+                int a = byMinX[k];
+                if (envelopes[a].intersects(window) && !visit(a)) return false;
+            }
+            return true;
+        }
+    };
+
+    const MonotoneChains& monotoneChains() const {
+        auto cached = std::atomic_load(&chainCache);
+        if (!cached) {
+            auto computed = std::make_shared<const MonotoneChains>(buildMonotoneChains());
+            if (std::atomic_compare_exchange_strong(&chainCache, &cached, computed)) {
+                cached = computed;
+            }
+        }
+        return *cached;
+    }
+
+    MonotoneChains buildMonotoneChains() const {
+        MonotoneChains result;
+        int n = ring.size();
+        auto close = [&](int first, int end, int xSign) {
+            if (end == first) return;
+            result.chains.push_back(Chain{first, end - first, xSign < 0});
+            result.envelopes.emplace_back(LineSegment(ring[first], ring[end % n]));
+        };
+
+        int first = 0;
+        int xSign = 0, ySign = 0;
+        for (int i = 0; i < n; i++) {
+            int dx = (dxs[i] > 0) - (dxs[i] < 0);
+            int dy = (dys[i] > 0) - (dys[i] < 0);
+            if ((dx != 0 && xSign != 0 && dx != xSign) || (dy != 0 && ySign != 0 && dy != ySign)) {
+                close(first, i, xSign);
+                first = i;
+                xSign = ySign = 0;
+            }
+            if (dx != 0) xSign = dx;
+            if (dy != 0) ySign = dy;
+        }
+        close(first, n, xSign);
+
+        for (int a = 0; a < (int)result.chains.size(); a++) {
+            result.byMinX.push_back(a);
+        }
+        std::sort(result.byMinX.begin(), result.byMinX.end(), [&](int a, int b) {
+            return result.envelopes[a].minX < result.envelopes[b].minX;
+        });
+        double reach = -HUGE_VAL;
+        for (int a : result.byMinX) {
+            reach = std::max(reach, result.envelopes[a].maxX);
+            result.reachX.push_back(reach);
+        }
+        return result;
+    }
+
+    // The part of a chain whose edges meet the x-range [minX, maxX], found by
+    // binary search since the edges are sorted by x.
+    Chain clipChain(const Chain& c, double minX, double maxX) const {
+        int n = ring.size();
+        auto edgeMinX = [&](int k) {
+            int i = chainEdge(c, k);
+            return std::min(xs[i], xs[i + 1]);
+        };
+        auto edgeMaxX = [&](int k) {
+            int i = chainEdge(c, k);
+            return std::max(xs[i], xs[i + 1]);
+        };
+
+        int low = 0, high = c.count;
+        while (low < high) {
+            int mid = (low + high) / 2;
+            if (edgeMaxX(mid) < minX) low = mid + 1; else high = mid;
+        }
+        int begin = low;
+        high = c.count;
+        while (low < high) {
+            int mid = (low + high) / 2;
+            if (edgeMinX(mid) <= maxX) low = mid + 1; else high = mid;
+        }
+        int end = low;
+
+        int first = c.reversed ? c.first + c.count - end : c.first + begin;
+        return Chain{first % n, end - begin, c.reversed};
+    }
+
+    // Edge index of the k-th edge of a chain in order of increasing x.
+    int chainEdge(const Chain& c, int k) const {
+        int n = ring.size();
+        return (c.first + (c.reversed ? c.count - 1 - k : k)) % n;
+    }
+
+    // Visits every pair of edges from two x-monotone chains whose closed x-ranges
+    // overlap. Both chains are walked once, so the cost is linear in their length.
+    template <typename Visitor>
+    void mergeChains(const Chain& c1, const Polygon& other, const Chain& c2, Visitor visit) const {
+        int start = 0;
+        for (int k1 = 0; k1 < c1.count; k1++) {
+            int i = chainEdge(c1, k1);
+            double minX = std::min(xs[i], xs[i + 1]);
+            double maxX = std::max(xs[i], xs[i + 1]);
+            double minY = std::min(ys[i], ys[i + 1]);
+            double maxY = std::max(ys[i], ys[i + 1]);
+
+            while (start < c2.count) {
+                int j = other.chainEdge(c2, start);
+                if (std::max(other.xs[j], other.xs[j + 1]) >= minX) break;
+                start++;
+            }
+
+            for (int k2 = start; k2 < c2.count; k2++) {
+                int j = other.chainEdge(c2, k2);
+                if (std::min(other.xs[j], other.xs[j + 1]) > maxX) break;
+                if (std::max(other.ys[j], other.ys[j + 1]) < minY ||
+                    std::min(other.ys[j], other.ys[j + 1]) > maxY) continue;
+                if (!visit(i, j)) return;
+            }
+        }
+    }
+
+    // True if an edge normal of this box puts all of other's corners more than
+    // tolerance outside.
+    bool boxSeparates(const Polygon& other, double tolerance) const {
+        for (int i = 0; i < 4; i++) {
+            double nx = dys[i] * orientation;
+            double ny = -dxs[i] * orientation;
+            double edge = nx * xs[i] + ny * ys[i];
+            double nearest = HUGE_VAL;
+            for (int j = 0; j < 4; j++) {
+                nearest = std::min(nearest, nx * other.xs[j] + ny * other.ys[j]);
+            }
+            if (nearest - edge > tolerance * std::sqrt(nx * nx + ny * ny)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // True if every corner of this box lies inside or on other.
+    bool boxCornersInside(const Polygon& other) const {
+        bool inside = true;
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                inside &= other.edgeSide(j, xs[i], ys[i]) * other.orientation >= 0;
+            }
+        }
+        return inside;
+    }
+
+    // Four vertices with alternating horizontal and vertical edges make an
+    // axis-aligned box. A convex quadrilateral with opposite sides parallel and
+    // right angles, to within rounding, is an oriented box.
+    void detectBox() {
+        boxKind = NOT_A_BOX;
+        if (ring.size() != 4 || !convex || minEdgeLength() == 0) {
+            return;
+        }
+
+        bool alternating = true;
+        for (int start = 0; start < 2; start++) {
+            alternating = true;
+            for (int i = 0; i < 4; i++) {
+                bool vertical = (i + start) % 2 == 0;
+                alternating &= vertical ? dxs[i] == 0 : dys[i] == 0;
+            }
+            if (alternating) {
+                boxKind = AXIS_ALIGNED_BOX;
+                return;
+            }
+        }
+
+        for (int i = 0; i < 4; i++) {
+            int next = (i + 1) % 4;
+            double dot = dxs[i] * dxs[next] + dys[i] * dys[next];
+            double scale = std::abs(dxs[i] * dys[next]) + std::abs(dys[i] * dxs[next]);
+            if (std::abs(dot) > 1e-9 * scale) {
+                return;
+            }
+        }
+        boxKind = ORIENTED_BOX;
+    }
+
+    // Convex when every turn has the same sign and the edge directions change
+    // x and y sign at most twice each, which rules out self-overlapping rings.
+    // Repeated vertices disqualify a ring, since the wedge search in
+    // convexContains needs every edge to have a direction.
+    void detectConvexity() {
+        int n = ring.size();
+        double area = 0;
+        for (int i = 0; i < n; i++) {
+            area += xs[i] * ys[i + 1] - xs[i + 1] * ys[i];
+        }
+        orientation = area > 0 ? 1 : (area < 0 ? -1 : 0);
+
+        convex = n >= 3 && orientation != 0;
+        int xFlips = 0, yFlips = 0;
+        double lastDx = 0, lastDy = 0;
+        for (int i = 0; i < n && convex; i++) {
+            int next = (i + 1) % n;
+            double turn = orient2d(xs[i], ys[i], xs[next], ys[next], xs[next + 1], ys[next + 1]);
+            if (turn * orientation < 0 || (dxs[i] == 0 && dys[i] == 0)) {
+                convex = false;
+            }
+            if (dxs[i] != 0) {
+                if (lastDx != 0 && (dxs[i] > 0) != (lastDx > 0)) xFlips++;
+                lastDx = dxs[i];
+            }
+            if (dys[i] != 0) {
+                if (lastDy != 0 && (dys[i] > 0) != (lastDy > 0)) yFlips++;
+                lastDy = dys[i];
+            }
+        }
+        if (xFlips > 2 || yFlips > 2) {
+            convex = false;
+        }
+    }
+
+    void scanEdgeTileScalar(int i0, int i1, const Polygon& other, int j0, int j1, bool& crossing,
+                            bool& touching) const;
+#ifdef POLYGON_X86_KERNELS
+    __attribute__((target("avx2")))
+    void scanEdgeTileAvx2(int i0, int i1, const Polygon& other, int j0, int j1, bool& crossing,
+                          bool& touching) const;
+#endif
+
+    std::vector<Point> ring;
+    BoundingBox box;
+
+    // Structure-of-arrays copy of the vertices. xs and ys repeat the first vertex
+    // at the end, so edge i runs from index i to i + 1 with delta (dxs[i], dys[i]).
+    std::vector<double> xs, ys;
+    std::vector<double> dxs, dys;
+
+    // Set at construction. orientation is 1 for counter-clockwise vertex order,
+    // -1 for clockwise and 0 for a degenerate ring.
+    bool convex;
+    int orientation;
+    BoxKind boxKind;
+
+    mutable std::shared_ptr<const std::vector<Point>> hullCache;
+    mutable std::shared_ptr<const MonotoneChains> chainCache;
+    mutable std::shared_ptr<const EdgeHierarchy> hierarchyCache;
+};
+
+class PreparedPolygon {
+public:
+    explicit PreparedPolygon(const Polygon& polygon) : source(polygon) {
+        buildSlabs();
+    }
+
+    const std::vector<Point>& vertices() const {
+        return source.vertices();
+    }
+
+    const BoundingBox& bounds() const {
+        return source.bounds();
+    }
+
+    bool isCounterClockwise() const {
+        return source.orientation > 0;
+    }
+
+    // Computed on first use and cached, so it costs nothing unless the hull
+    // filter stage is enabled.
+    const std::vector<Point>& convexHull() const {
+        return source.convexHull();
+    }
+
+    // Same answers as Polygon::contains, visiting only the edges of p's slab
+    // and the long edges.
+    bool contains(const Point& p) const {
+        if (!bounds().contains(p)) {
+            return false;
+        }
+
+        int slab = slabOf(p.y);
+        bool boundary = false;
+        int count = 0;
+        auto cross = [&](int i) {
+            double x1 = source.xs[i], y1 = source.ys[i];
+            double x2 = source.xs[i + 1], y2 = source.ys[i + 1];
+            if (p.y < std::min(y1, y2) || p.y > std::max(y1, y2)) return;
+
+            double side = source.edgeSide(i, p.x, p.y);
+            boundary |= side == 0 && std::min(x1, x2) <= p.x && p.x <= std::max(x1, x2);
+            count += (y1 > p.y) != (y2 > p.y) && (side > 0) == (y2 > y1);
+        };
+        for (int k = slabStart[slab]; k < slabStart[slab + 1]; k++) {
+            cross(slabEdges[k]);
+        }
+        for (int i : longEdges) {
+            cross(i);
+        }
+
+        return boundary || count % 2 == 1;
+    }
+
+    // Candidates are classified as they are, without preparing them. The edge
+    // stage runs on the prepared ring, whose monotone chains and edge hierarchy
+    // are built once and reused for every candidate, and the containment
+    // stage places candidates inside this ring through the slabs.
+    Relationship classify(const Polygon& other) const {
+        if (classifyFilters().rejects(*this, other)) {
+            return Relationship::OUTSIDE;
+        }
+        Relationship relationship;
+        if (source.classifyBoundaries(other, relationship)) {
+            return relationship;
+        }
+        return classifyContainment(other.bounds(), other.vertices()[0],
+                                   [&](const Point& p) { return other.contains(p); });
+    }
+
+    Relationship classify(const PreparedPolygon& other) const {
+        if (classifyFilters().rejects(*this, other)) {
+            return Relationship::OUTSIDE;
+        }
+        Relationship relationship;
+        if (source.classifyBoundaries(other.source, relationship)) {
+            return relationship;
+        }
+        return classifyContainment(other.bounds(), other.vertices()[0],
+                                   [&](const Point& p) { return other.contains(p); });
+    }
+
+private:
+    // Edges spanning more slabs than this are kept once in longEdges instead
+    // of in every slab, which bounds the index at SLAB_SPAN_LIMIT entries per
+    // edge.
+    static constexpr int SLAB_SPAN_LIMIT = 4;
+
+    Polygon source;
+
+    // Edges bucketed by the horizontal slabs their y-range spans, so a point
+    // query only visits edges that can reach its y coordinate. The edges of
+    // slab s are slabEdges[slabStart[s]] up to slabEdges[slabStart[s + 1]].
+    std::vector<int> slabStart;
+    std::vector<int> slabEdges;
+    std::vector<int> longEdges;
+    int slabCount;
+    double slabHeight;
+
+    // Disjoint boundaries: one vertex of each ring decides.
+    template <typename Contains>
+    Relationship classifyContainment(const BoundingBox& otherBounds, const Point& otherVertex,
+                                     Contains otherContains) const {
+        if ((bounds().contains(otherBounds) && contains(otherVertex)) ||
+            (otherBounds.contains(bounds()) && otherContains(vertices()[0]))) {
+            return Relationship::ENCLOSED;
+        }
+        return Relationship::OUTSIDE;
+    }
+
+    void buildSlabs() {
+        int n = vertices().size();
+        slabCount = std::max<int>(1, std::sqrt((double)n));
+        slabHeight = (bounds().maxY - bounds().minY) / slabCount;
+
+        // Counted first and filled second, so each slab's run is allocated once.
+        slabStart.assign(slabCount + 1, 0);
+        std::vector<int> fill;
+        for (int pass = 0; pass < 2; pass++) {
+            for (int i = 0; i < n; i++) {
+                int first = slabOf(std::min(source.ys[i], source.ys[i + 1]));
+                int last = slabOf(std::max(source.ys[i], source.ys[i + 1]));
+                if (last - first >= SLAB_SPAN_LIMIT) {
+                    if (pass == 1) longEdges.push_back(i);
+                    continue;
+                }
+                for (int slab = first; slab <= last; slab++) {
+                    if (pass == 0) {
+                        slabStart[slab + 1]++;
+                    } else {
+                        slabEdges[fill[slab]++] = i;
+                    }
+                }
+            }
+            if (pass == 0) {
+                for (int slab = 0; slab < slabCount; slab++) {
+                    slabStart[slab + 1] += slabStart[slab];
+                }
+                slabEdges.resize(slabStart[slabCount]);
+                fill.assign(slabStart.begin(), slabStart.end() - 1);
+            }
+        }
+    }
+
+    int slabOf(double y) const {
+        if (!(slabHeight > 0)) return 0;
+        int slab = (int)((y - bounds().minY) / slabHeight);
+        return std::max(0, std::min(slabCount - 1, slab));
+    }
+};
+
+Relationship Polygon::classify(const PreparedPolygon& other) const {
+    return other.classify(*this);
+}
+
+// Greiner-Hormann clipping. The algorithm cannot place an intersection that
+// falls on a vertex, so vertices lying on the other polygon's boundary are first
+// moved a tiny step into the other polygon. The output uses their original
+// coordinates, and rings that collapse to slivers after that are dropped.
+class PolygonClipper {
+public:
+    PolygonClipper(const std::vector<Point>& subject, const std::vector<Point>& clip)
+        : subject(counterClockwise(subject)), clip(counterClockwise(clip)) {}
+
+    ClipResult intersection() {
+        ClipResult result;
+        if (subject.size() < 3 || clip.size() < 3) {
+            return result;
+        }
+
+        BoundingBox extent(subject);
+        for (const auto& p : clip) {
+            extent.expand(p);
+        }
+        step = 1e-9 * std::max(extent.maxX - extent.minX, extent.maxY - extent.minY);
+        if (!(step > 0)) {
+            return result;
+        }
+
+        std::vector<Point> movedSubject = subject, movedClip = clip;
+        const int attempts = 8;
+        for (int attempt = 0; attempt < attempts; attempt++) {
+            if (build(movedSubject, movedClip)) {
+                break;
+            }
+            if (attempt == attempts - 1) {
+                return result;
+            }
+        }
+
+        if (crossings == 0) {
+            if (inside(movedClip, movedSubject[0])) {
+                result.rings.push_back(subject);
+            } else if (inside(movedSubject, movedClip[0])) {
+                result.rings.push_back(clip);
+            }
+        } else {
+            traverse(result.rings);
+        }
+
+        for (const auto& ring : result.rings) {
+            result.area += signedArea(ring);
+        }
+        return result;
+    }
+
+private:
+    struct Node {
+        Point point;
+        int next, prev;
+        int neighbor;
+        bool entry;
+        bool visited;
+    };
+
+    std::vector<Point> subject, clip;
+    std::vector<Point> moved;
+    std::vector<Node> nodes;
+    int subjectHead, clipHead;
+    int crossings;
+    double step;
+
+    // Even-odd test with a half-open rule; only used on points that are at least
+    // a step away from the boundary.
+    static bool inside(const std::vector<Point>& ring, const Point& p) {
+        bool in = false;
+        int n = ring.size();
+        for (int i = 0; i < n; i++) {
+            const Point& a = ring[i];
+            const Point& b = ring[(i + 1) % n];
+            if ((a.y > p.y) != (b.y > p.y)) {
+                double x = a.x + (p.y - a.y) * (b.x - a.x) / (b.y - a.y);
+                if (x > p.x) in = !in;
+            }
+        }
+        return in;
+    }
+
+    static double distanceToSegment(const Point& p, const Point& a, const Point& b) {
+        double dx = b.x - a.x, dy = b.y - a.y;
+        double length = dx * dx + dy * dy;
+        double t = length > 0 ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / length : 0;
+        t = std::max(0.0, std::min(1.0, t));
+        return std::hypot(p.x - a.x - t * dx, p.y - a.y - t * dy);
+    }
+
+    static double distanceToRing(const Point& p, const std::vector<Point>& ring) {
+        double nearest = HUGE_VAL;
+        for (std::size_t i = 0; i < ring.size(); i++) {
+            nearest = std::min(nearest, distanceToSegment(p, ring[i], ring[(i + 1) % ring.size()]));
+        }
+        return nearest;
+    }
+
+    // Moves p a step into ring, remembering the original coordinates for the
+    // output. Candidate directions are sixteen evenly spaced ones plus the
+    // bisectors and normals of nearby corners and edges of ring, so narrow
+    // wedges are entered along their middle; the candidate ending furthest from
+    // ring's boundary wins.
+    void moveInside(Point& p, const std::vector<Point>& ring) {
+        std::vector<Point> directions;
+        for (int k = 0; k < 16; k++) {
+            directions.emplace_back(std::cos(k * M_PI / 8), std::sin(k * M_PI / 8));
+        }
+        int n = ring.size();
+        for (int k = 0; k < n; k++) {
+            const Point& corner = ring[k];
+            const Point& next = ring[(k + 1) % n];
+            const Point& previous = ring[(k + n - 1) % n];
+            if (std::hypot(p.x - corner.x, p.y - corner.y) <= step) {
+                double l1 = std::hypot(previous.x - corner.x, previous.y - corner.y);
+                double l2 = std::hypot(next.x - corner.x, next.y - corner.y);
+                if (l1 > 0 && l2 > 0) {
+                    Point bisector((previous.x - corner.x) / l1 + (next.x - corner.x) / l2,
+                                   (previous.y - corner.y) / l1 + (next.y - corner.y) / l2);
+                    double length = std::hypot(bisector.x, bisector.y);
+                    if (length > 0) {
+                        directions.emplace_back(bisector.x / length, bisector.y / length);
+                        directions.emplace_back(-bisector.x / length, -bisector.y / length);
+                    }
+                }
+            }
+            double length = std::hypot(next.x - corner.x, next.y - corner.y);
+            if (length > 0 && distanceToSegment(p, corner, next) <= step) {
+                directions.emplace_back(-(next.y - corner.y) / length, (next.x - corner.x) / length);
+                directions.emplace_back((next.y - corner.y) / length, -(next.x - corner.x) / length);
+            }
+        }
+
+        moved.push_back(p);
+        Point original = p, best(original.x + step, original.y);
+        double bestDistance = -1;
+        for (const auto& direction : directions) {
+            Point candidate(original.x + step * direction.x, original.y + step * direction.y);
+            if (!inside(ring, candidate)) continue;
+            double distance = distanceToRing(candidate, ring);
+            if (distance > bestDistance) {
+                best = candidate;
+                bestDistance = distance;
+            }
+        }
+        p = best;
+    }
+
+    Point output(const Point& p) const {
+        for (const auto& original : moved) {
+            if (std::abs(p.x - original.x) <= 4 * step && std::abs(p.y - original.y) <= 4 * step) {
+                return original;
+            }
+        }
+        return p;
+    }
+
+    // Finds the proper crossings of s and c and links both rings with them.
+    // Returns false after moving any vertex that lies within a small fraction of
+    // a step of the other ring's boundary, in which case the caller retries.
+    bool build(std::vector<Point>& s, std::vector<Point>& c) {
+        int n = s.size(), m = c.size();
+        double tolerance = step / 1024;
+        std::vector<bool> degenerateS(n, false), degenerateC(m, false);
+
+        struct Hit {
+            double alpha;
+            int node;
+        };
+        std::vector<std::vector<Hit>> hitsS(n), hitsC(m);
+        nodes.clear();
+        crossings = 0;
+
+        for (int i = 0; i < n; i++) {
+            const Point& p1 = s[i];
+            const Point& p2 = s[(i + 1) % n];
+            BoundingBox edgeS(std::min(p1.x, p2.x) - tolerance, std::min(p1.y, p2.y) - tolerance,
+                              std::max(p1.x, p2.x) + tolerance, std::max(p1.y, p2.y) + tolerance);
+            for (int j = 0; j < m; j++) {
+                const Point& q1 = c[j];
+                const Point& q2 = c[(j + 1) % m];
+                if (!edgeS.intersects(BoundingBox(LineSegment(q1, q2)))) continue;
+
+                bool degenerate = false;
+                if (distanceToSegment(p1, q1, q2) <= tolerance) degenerate = degenerateS[i] = true;
+                if (distanceToSegment(p2, q1, q2) <= tolerance) degenerate = degenerateS[(i + 1) % n] = true;
+                if (distanceToSegment(q1, p1, p2) <= tolerance) degenerate = degenerateC[j] = true;
+                if (distanceToSegment(q2, p1, p2) <= tolerance) degenerate = degenerateC[(j + 1) % m] = true;
+                if (degenerate) continue;
+
+                double rx = p2.x - p1.x, ry = p2.y - p1.y;
+                double sx = q2.x - q1.x, sy = q2.y - q1.y;
+                double denominator = rx * sy - ry * sx;
+                if (denominator == 0) continue;
+                double t = ((q1.x - p1.x) * sy - (q1.y - p1.y) * sx) / denominator;
+                double u = ((q1.x - p1.x) * ry - (q1.y - p1.y) * rx) / denominator;
+                if (!(t > 0 && t < 1 && u > 0 && u < 1)) continue;
+
+                Point point(p1.x + t * rx, p1.y + t * ry);
+                int a = nodes.size();
+                nodes.push_back({point, -1, -1, a + 1, false, false});
+                nodes.push_back({point, -1, -1, a, false, false});
+                hitsS[i].push_back({t, a});
+                hitsC[j].push_back({u, a + 1});
+                crossings++;
+            }
+        }
+
+        // Subject vertices move first; clip vertices only once the subject is
+        // clean, so the two rings never chase each other.
+        bool clean = true;
+        for (int i = 0; i < n; i++) {
+            if (degenerateS[i]) {
+                moveInside(s[i], c);
+                clean = false;
+            }
+        }
+        for (int j = 0; j < m && clean; j++) {
+            clean = !degenerateC[j];
+        }
+        for (int j = 0; j < m; j++) {
+            if (degenerateC[j] && std::none_of(degenerateS.begin(), degenerateS.end(),
+                                                [](bool b) { return b; })) {
+                moveInside(c[j], s);
+            }
+        }
+        if (!clean) {
+            return false;
+        }
+
+        subjectHead = link(s, hitsS);
+        clipHead = link(c, hitsC);
+        markEntries(subjectHead, inside(c, s[0]));
+        markEntries(clipHead, inside(s, c[0]));
+        return true;
+    }
+
+    template <typename Hits>
+    int link(const std::vector<Point>& ring, std::vector<Hits>& hits) {
+        int head = nodes.size(), last = -1;
+        for (int i = 0; i < (int)ring.size(); i++) {
+            std::sort(hits[i].begin(), hits[i].end(),
+                      [](const auto& h1, const auto& h2) { return h1.alpha < h2.alpha; });
+            int vertex = nodes.size();
+            nodes.push_back({ring[i], -1, -1, -1, false, false});
+            append(last, vertex);
+            for (const auto& hit : hits[i]) {
+                append(last, hit.node);
+            }
+        }
+        nodes[last].next = head;
+        nodes[head].prev = last;
+        return head;
+    }
+
+    void append(int& last, int node) {
+        if (last >= 0) {
+            nodes[last].next = node;
+            nodes[node].prev = last;
+        }
+        last = node;
+    }
+
+    void markEntries(int head, bool startsInside) {
+        bool entry = !startsInside;
+        int node = head;
+        do {
+            if (nodes[node].neighbor >= 0) {
+                nodes[node].entry = entry;
+                entry = !entry;
+            }
+            node = nodes[node].next;
+        } while (node != head);
+    }
+
+    void traverse(std::vector<std::vector<Point>>& rings) {
+        int node = subjectHead;
+        do {
+            if (nodes[node].neighbor >= 0 && nodes[node].entry && !nodes[node].visited) {
+                std::vector<Point> ring;
+                int current = node;
+                ring.push_back(output(nodes[current].point));
+                do {
+                    nodes[current].visited = nodes[nodes[current].neighbor].visited = true;
+                    bool forward = nodes[current].entry;
+                    do {
+                        current = forward ? nodes[current].next : nodes[current].prev;
+                        Point p = output(nodes[current].point);
+                        if (!areSame(p, ring.back())) ring.push_back(p);
+                    } while (nodes[current].neighbor < 0);
+                    current = nodes[current].neighbor;
+                } while (!nodes[current].visited);
+
+                while (ring.size() > 1 && areSame(ring.front(), ring.back())) {
+                    ring.pop_back();
+                }
+                if (!isSliver(ring)) {
+                    rings.push_back(ring);
+                }
+            }
+            node = nodes[node].next;
+        } while (node != subjectHead);
+    }
+
+    static bool areSame(const Point& p, const Point& q) {
+        return p.x == q.x && p.y == q.y;
+    }
+
+    bool isSliver(const std::vector<Point>& ring) const {
+        if (ring.size() < 3) {
+            return true;
+        }
+        double perimeter = 0;
+        for (std::size_t i = 0; i < ring.size(); i++) {
+            const Point& p = ring[i];
+            const Point& q = ring[(i + 1) % ring.size()];
+            perimeter += std::hypot(q.x - p.x, q.y - p.y);
+        }
+        return std::abs(signedArea(ring)) <= 4 * step * perimeter;
+    }
+};
+
+// Skips clipping when classify already settles the answer: disjoint pairs share
+// nothing and an enclosed pair shares the inner polygon.
+ClipResult Polygon::intersection(const Polygon& other) const {
+    Relationship relationship = classify(other);
+    if (relationship == Relationship::OUTSIDE) {
+        return ClipResult();
+    }
+    if (relationship == Relationship::ENCLOSED) {
+        const Polygon& inner = area() <= other.area() ? *this : other;
+        ClipResult result;
+        result.rings.push_back(counterClockwise(inner.vertices()));
+        result.area = inner.area();
+        return result;
+    }
+    return PolygonClipper(ring, other.ring).intersection();
+}
+
+// Per-edge data for the batch point-in-polygon kernels. The vector kernels run
+// the floating-point half of orient2d with its error bound and send the points
+// whose sign they cannot certify to containsScalar, so every kernel returns
+// exactly what Polygon::contains does.
+struct BatchEdge {
+    double x1, y1, x2, y2;
+    double minX, maxX, minY, maxY;
+};
+
+std::vector<BatchEdge> batchEdges(const std::vector<Point>& vertices) {
+    std::vector<BatchEdge> edges;
+    edges.reserve(vertices.size());
+    for (const auto& edge : EdgeView(vertices)) {
+        const Point& v1 = edge.p1;
+        const Point& v2 = edge.p2;
+        edges.push_back({v1.x, v1.y, v2.x, v2.y,
+                         std::min(v1.x, v2.x), std::max(v1.x, v2.x),
+                         std::min(v1.y, v2.y), std::max(v1.y, v2.y)});
+    }
+    return edges;
+}
+
+bool containsScalar(const std::vector<BatchEdge>& edges, double px, double py) {
+    bool parity = false;
+    for (const auto& e : edges) {
+        if (py < e.minY || py > e.maxY) continue;
+
+        double side = orient2d(e.x1, e.y1, e.x2, e.y2, px, py);
+        if (side == 0 && e.minX <= px && px <= e.maxX) {
+            return true;
+        }
+        if ((e.y1 > py) != (e.y2 > py) && (side > 0) == (e.y2 > e.y1)) {
+            parity = !parity;
+        }
+    }
+    return parity;
+}
+
+void containsBatchScalar(const std::vector<BatchEdge>& edges, const double* xs,
+                         const double* ys, std::size_t first, std::size_t count,
+                         std::uint64_t* mask) {
+    for (std::size_t i = first; i < count; i++) {
+        if (containsScalar(edges, xs[i], ys[i])) {
+            mask[i / 64] |= std::uint64_t(1) << (i % 64);
+        }
+    }
+}
+
+// Sets the mask bits of a vector of points from the lane bits of the parity,
+// re-running the lanes whose orientation was uncertain through containsScalar.
+inline void storeBatchLanes(const std::vector<BatchEdge>& edges, const double* xs,
+                            const double* ys, std::size_t i, int lanes, int parityBits,
+                            int uncertainBits, std::uint64_t* mask) {
+    for (int lane = 0; lane < lanes; lane++) {
+        std::size_t k = i + lane;
+        bool inside = (uncertainBits >> lane) & 1 ? containsScalar(edges, xs[k], ys[k])
+                                                  : (parityBits >> lane) & 1;
+        if (inside) {
+            mask[k / 64] |= std::uint64_t(1) << (k % 64);
+        }
+    }
+}
+
+#ifdef POLYGON_X86_KERNELS
+std::size_t containsBatchSse2(const std::vector<BatchEdge>& edges, const double* xs,
+                              const double* ys, std::size_t count, std::uint64_t* mask) {
+    const __m128d signBit = _mm_set1_pd(-0.0);
+    const __m128d errorBound = _mm_set1_pd(ORIENT_ERROR_BOUND);
+    const __m128d zero = _mm_setzero_pd();
+
+    std::size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d px = _mm_loadu_pd(xs + i);
+        __m128d py = _mm_loadu_pd(ys + i);
+        __m128d parity = _mm_setzero_pd();
+        __m128d uncertain = _mm_setzero_pd();
+
+        for (const auto& e : edges) {
+            __m128d inY = _mm_and_pd(_mm_cmple_pd(_mm_set1_pd(e.minY), py),
+                                     _mm_cmple_pd(py, _mm_set1_pd(e.maxY)));
+            if (_mm_movemask_pd(inY) == 0) continue;
+
+            __m128d left = _mm_mul_pd(_mm_sub_pd(_mm_set1_pd(e.x1), px),
+                                      _mm_sub_pd(_mm_set1_pd(e.y2), py));
+            __m128d right = _mm_mul_pd(_mm_sub_pd(_mm_set1_pd(e.y1), py),
+                                       _mm_sub_pd(_mm_set1_pd(e.x2), px));
+            __m128d det = _mm_sub_pd(left, right);
+            __m128d bound = _mm_mul_pd(errorBound, _mm_add_pd(_mm_andnot_pd(signBit, left),
+                                                              _mm_andnot_pd(signBit, right)));
+            __m128d sure = _mm_cmpgt_pd(_mm_andnot_pd(signBit, det), bound);
+            uncertain = _mm_or_pd(uncertain, _mm_andnot_pd(sure, inY));
+
+            __m128d spans = _mm_xor_pd(_mm_cmpgt_pd(_mm_set1_pd(e.y1), py),
+                                       _mm_cmpgt_pd(_mm_set1_pd(e.y2), py));
+            __m128d onSide = e.y2 > e.y1 ? _mm_cmpgt_pd(det, zero) : _mm_cmplt_pd(det, zero);
+            parity = _mm_xor_pd(parity, _mm_and_pd(spans, onSide));
+        }
+
+        storeBatchLanes(edges, xs, ys, i, 2, _mm_movemask_pd(parity),
+                        _mm_movemask_pd(uncertain), mask);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+std::size_t containsBatchAvx2(const std::vector<BatchEdge>& edges, const double* xs,
+                              const double* ys, std::size_t count, std::uint64_t* mask) {
+    const __m256d signBit = _mm256_set1_pd(-0.0);
+    const __m256d errorBound = _mm256_set1_pd(ORIENT_ERROR_BOUND);
+    const __m256d zero = _mm256_setzero_pd();
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d px = _mm256_loadu_pd(xs + i);
+        __m256d py = _mm256_loadu_pd(ys + i);
+        __m256d parity = _mm256_setzero_pd();
+        __m256d uncertain = _mm256_setzero_pd();
+
+        for (const auto& e : edges) {
+            __m256d inY = _mm256_and_pd(_mm256_cmp_pd(_mm256_set1_pd(e.minY), py, _CMP_LE_OQ),
+                                        _mm256_cmp_pd(py, _mm256_set1_pd(e.maxY), _CMP_LE_OQ));
+            if (_mm256_movemask_pd(inY) == 0) continue;
+
+            __m256d left = _mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(e.x1), px),
+                                         _mm256_sub_pd(_mm256_set1_pd(e.y2), py));
+            __m256d right = _mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(e.y1), py),
+                                          _mm256_sub_pd(_mm256_set1_pd(e.x2), px));
+            __m256d det = _mm256_sub_pd(left, right);
+            __m256d bound = _mm256_mul_pd(
+                errorBound, _mm256_add_pd(_mm256_andnot_pd(signBit, left),
+                                          _mm256_andnot_pd(signBit, right)));
+            __m256d sure = _mm256_cmp_pd(_mm256_andnot_pd(signBit, det), bound, _CMP_GT_OQ);
+            uncertain = _mm256_or_pd(uncertain, _mm256_andnot_pd(sure, inY));
+
+            __m256d spans = _mm256_xor_pd(_mm256_cmp_pd(_mm256_set1_pd(e.y1), py, _CMP_GT_OQ),
+                                          _mm256_cmp_pd(_mm256_set1_pd(e.y2), py, _CMP_GT_OQ));
+            __m256d onSide = e.y2 > e.y1 ? _mm256_cmp_pd(det, zero, _CMP_GT_OQ)
+                                         : _mm256_cmp_pd(det, zero, _CMP_LT_OQ);
+            parity = _mm256_xor_pd(parity, _mm256_and_pd(spans, onSide));
+        }
+
+        storeBatchLanes(edges, xs, ys, i, 4, _mm256_movemask_pd(parity),
+                        _mm256_movemask_pd(uncertain), mask);
+    }
+    return i;
+}
+#endif
+
+enum class BatchKernel { SCALAR, SSE2, AVX2 };
+
+BatchKernel detectBatchKernel() {
+#ifdef POLYGON_X86_KERNELS
+    if (__builtin_cpu_supports("avx2")) return BatchKernel::AVX2;
+    if (__builtin_cpu_supports("sse2")) return BatchKernel::SSE2;
+#endif
+    return BatchKernel::SCALAR;
+}
+
+BatchKernel activeBatchKernel() {
+    static const BatchKernel kernel = detectBatchKernel();
+    return kernel;
+}
+
+void containsBatch(const std::vector<BatchEdge>& edges, const double* xs, const double* ys,
+                   std::size_t count, std::uint64_t* mask, BatchKernel kernel) {
+    std::fill(mask, mask + (count + 63) / 64, 0);
+
+    std::size_t done = 0;
+#ifdef POLYGON_X86_KERNELS
+    if (kernel == BatchKernel::AVX2) {
+        done = containsBatchAvx2(edges, xs, ys, count, mask);
+    } else if (kernel == BatchKernel::SSE2) {
+        done = containsBatchSse2(edges, xs, ys, count, mask);
+    }
+#else
+    (void)kernel;
+#endif
+    containsBatchScalar(edges, xs, ys, done, count, mask);
+}
+
+// Tests count points at once. Bit i % 64 of mask[i / 64] is set when
+// (xs[i], ys[i]) is inside or on the boundary, exactly as contains() reports it.
+// mask must hold (count + 63) / 64 words.
+void Polygon::containsBatch(const double* xs, const double* ys, std::size_t count,
+                            std::uint64_t* mask) const {
+    ::containsBatch(batchEdges(ring), xs, ys, count, mask, activeBatchKernel());
+}
+
+// Classifies query against count axis-aligned boxes given as separate minX, minY,
+// maxX and maxY arrays and writes one Relationship per box to relations. Each
+// result equals classifyAlignedBoxes(query, box). Runs four boxes per step with
+// AVX2 when the CPU has it.
+void classifyAlignedBoxesBatch(const BoundingBox& query, const double* minX, const double* minY,
+                               const double* maxX, const double* maxY, std::size_t count,
+                               Relationship* relations);
+
+#ifdef POLYGON_X86_KERNELS
+__attribute__((target("avx2"))) inline __m256d insideAvx2(__m256d v, __m256d lo, __m256d hi) {
+    return _mm256_and_pd(_mm256_cmp_pd(lo, v, _CMP_LT_OQ), _mm256_cmp_pd(v, hi, _CMP_LT_OQ));
+}
+
+__attribute__((target("avx2"))) inline __m256d lessAvx2(__m256d a, __m256d b) {
+    return _mm256_cmp_pd(a, b, _CMP_LT_OQ);
+}
+
+__attribute__((target("avx2"))) inline __m256d lessEqualAvx2(__m256d a, __m256d b) {
+    return _mm256_cmp_pd(a, b, _CMP_LE_OQ);
+}
+
+__attribute__((target("avx2"))) inline __m256d equalAvx2(__m256d a, __m256d b) {
+    return _mm256_cmp_pd(a, b, _CMP_EQ_OQ);
+}
+
+__attribute__((target("avx2")))
+std::size_t classifyAlignedBoxesAvx2(const BoundingBox& query, const double* minX,
+                                     const double* minY, const double* maxX,
+                                     const double* maxY, std::size_t count,
+                                     Relationship* relations) {
+    const __m256d qMinX = _mm256_set1_pd(query.minX);
+    const __m256d qMinY = _mm256_set1_pd(query.minY);
+    const __m256d qMaxX = _mm256_set1_pd(query.maxX);
+    const __m256d qMaxY = _mm256_set1_pd(query.maxY);
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d bMinX = _mm256_loadu_pd(minX + i);
+        __m256d bMinY = _mm256_loadu_pd(minY + i);
+        __m256d bMaxX = _mm256_loadu_pd(maxX + i);
+        __m256d bMaxY = _mm256_loadu_pd(maxY + i);
+
+        __m256d outside = _mm256_or_pd(
+            _mm256_or_pd(lessAvx2(qMaxX, bMinX), lessAvx2(bMaxX, qMinX)),
+            _mm256_or_pd(lessAvx2(qMaxY, bMinY), lessAvx2(bMaxY, qMinY)));
+        __m256d queryXInBox = _mm256_or_pd(insideAvx2(qMinX, bMinX, bMaxX),
+                                           insideAvx2(qMaxX, bMinX, bMaxX));
+        __m256d boxYInQuery = _mm256_or_pd(insideAvx2(bMinY, qMinY, qMaxY),
+                                           insideAvx2(bMaxY, qMinY, qMaxY));
+        __m256d boxXInQuery = _mm256_or_pd(insideAvx2(bMinX, qMinX, qMaxX),
+                                           insideAvx2(bMaxX, qMinX, qMaxX));
+        __m256d queryYInBox = _mm256_or_pd(insideAvx2(qMinY, bMinY, bMaxY),
+                                           insideAvx2(qMaxY, bMinY, bMaxY));
+        __m256d crossing = _mm256_or_pd(_mm256_and_pd(queryXInBox, boxYInQuery),
+                                        _mm256_and_pd(boxXInQuery, queryYInBox));
+        __m256d touching = _mm256_or_pd(
+            _mm256_or_pd(_mm256_or_pd(equalAvx2(qMinX, bMinX), equalAvx2(qMinX, bMaxX)),
+                         _mm256_or_pd(equalAvx2(qMaxX, bMinX), equalAvx2(qMaxX, bMaxX))),
+            _mm256_or_pd(_mm256_or_pd(equalAvx2(qMinY, bMinY), equalAvx2(qMinY, bMaxY)),
+                         _mm256_or_pd(equalAvx2(qMaxY, bMinY), equalAvx2(qMaxY, bMaxY))));
+        __m256d enclosed = _mm256_or_pd(
+            _mm256_and_pd(_mm256_and_pd(lessEqualAvx2(bMinX, qMinX), lessEqualAvx2(qMaxX, bMaxX)),
+                          _mm256_and_pd(lessEqualAvx2(bMinY, qMinY), lessEqualAvx2(qMaxY, bMaxY))),
+            _mm256_and_pd(_mm256_and_pd(lessEqualAvx2(qMinX, bMinX), lessEqualAvx2(bMaxX, qMaxX)),
+                          _mm256_and_pd(lessEqualAvx2(qMinY, bMinY), lessEqualAvx2(bMaxY, qMaxY))));
+
+        int outsideBits = _mm256_movemask_pd(outside);
+        int crossingBits = _mm256_movemask_pd(crossing);
+        int touchingBits = _mm256_movemask_pd(touching);
+        int enclosedBits = _mm256_movemask_pd(enclosed);
+        for (int lane = 0; lane < 4; lane++) {
+            int bit = 1 << lane;
+            relations[i + lane] = (outsideBits & bit)    ? Relationship::OUTSIDE
+                                  : (crossingBits & bit) ? Relationship::INTERSECTING
+                                  : (touchingBits & bit) ? Relationship::TOUCHING
+                                  : (enclosedBits & bit) ? Relationship::ENCLOSED
+                                                         : Relationship::OUTSIDE;
+        }
+    }
+    return i;
+}
+#endif
+
+void classifyAlignedBoxesBatch(const BoundingBox& query, const double* minX, const double* minY,
+                               const double* maxX, const double* maxY, std::size_t count,
+                               Relationship* relations) {
+    std::size_t done = 0;
+#ifdef POLYGON_X86_KERNELS
+    if (activeBatchKernel() == BatchKernel::AVX2) {
+        done = classifyAlignedBoxesAvx2(query, minX, minY, maxX, maxY, count, relations);
+    }
+#endif
+    for (std::size_t i = done; i < count; i++) {
+        relations[i] = classifyAlignedBoxes(query, BoundingBox(minX[i], minY[i], maxX[i], maxY[i]));
+    }
+}
+
+// Classifies query against every box in boxes, which may be axis-aligned or
+// rotated. Axis-aligned pairs use classifyAlignedBoxes, others the oriented-box
+// kernel.
+void classifyBoxesBatch(const Polygon& query, const std::vector<Polygon>& boxes,
+                        Relationship* relations) {
+    for (std::size_t i = 0; i < boxes.size(); i++) {
+        if (query.shape() == Polygon::AXIS_ALIGNED_BOX &&
+            boxes[i].shape() == Polygon::AXIS_ALIGNED_BOX) {
+            relations[i] = classifyAlignedBoxes(query.bounds(), boxes[i].bounds());
+        } else {
+            relations[i] = query.classifyBoxes(boxes[i]);
+        }
+    }
+}
+
+// Edge pairs are compared in tiles of TILE_EDGES edges from each ring, so the
+// coordinates of both tiles stay in L1 while every pair between them is tested.
+const int TILE_EDGES = 256;
+
+void Polygon::scanEdgeTileScalar(int i0, int i1, const Polygon& other, int j0, int j1,
+                                 bool& crossing, bool& touching) const {
+    for (int i = i0; i < i1 && !crossing; i++) {
+        for (int j = j0; j < j1 && !crossing; j++) {
+            scanEdgePair(i, other, j, crossing, touching);
+        }
+    }
+}
+
+#ifdef POLYGON_X86_KERNELS
+// Floating-point orientation of (cx, cy) against a->b per lane, with sure set
+// where the sign clears the orient2d error bound.
+__attribute__((target("avx2"))) inline __m256d orientAvx2(__m256d ax, __m256d ay, __m256d bx,
+                                                           __m256d by, __m256d cx, __m256d cy,
+                                                           __m256d& sure) {
+    const __m256d signBit = _mm256_set1_pd(-0.0);
+    __m256d left = _mm256_mul_pd(_mm256_sub_pd(ax, cx), _mm256_sub_pd(by, cy));
+    __m256d right = _mm256_mul_pd(_mm256_sub_pd(ay, cy), _mm256_sub_pd(bx, cx));
+    __m256d det = _mm256_sub_pd(left, right);
+    __m256d bound = _mm256_mul_pd(_mm256_set1_pd(ORIENT_ERROR_BOUND),
+                                  _mm256_add_pd(_mm256_andnot_pd(signBit, left),
+                                                _mm256_andnot_pd(signBit, right)));
+    sure = _mm256_cmp_pd(_mm256_andnot_pd(signBit, det), bound, _CMP_GT_OQ);
+    return det;
+}
+
+// One edge of this polygon against four consecutive edges of other per step. Lanes
+// whose boxes overlap and whose four orientations are all sure decide crossing
+// outright and cannot touch, since touching needs a zero orientation; the
+// other overlapping lanes go through the exact scalar tests.
+__attribute__((target("avx2")))
+void Polygon::scanEdgeTileAvx2(int i0, int i1, const Polygon& other, int j0, int j1,
+                               bool& crossing, bool& touching) const {
+    const __m256d zero = _mm256_setzero_pd();
+    int vectorEnd = j0 + (j1 - j0) / 4 * 4;
+
+    for (int i = i0; i < i1 && !crossing; i++) {
+        __m256d ax = _mm256_set1_pd(xs[i]);
+        __m256d ay = _mm256_set1_pd(ys[i]);
+        __m256d bx = _mm256_set1_pd(xs[i + 1]);
+        __m256d by = _mm256_set1_pd(ys[i + 1]);
+        __m256d minX = _mm256_min_pd(ax, bx), maxX = _mm256_max_pd(ax, bx);
+        __m256d minY = _mm256_min_pd(ay, by), maxY = _mm256_max_pd(ay, by);
+
+        for (int j = j0; j < vectorEnd; j += 4) {
+            __m256d cx = _mm256_loadu_pd(other.xs.data() + j);
+            __m256d cy = _mm256_loadu_pd(other.ys.data() + j);
+            __m256d dx = _mm256_loadu_pd(other.xs.data() + j + 1);
+            __m256d dy = _mm256_loadu_pd(other.ys.data() + j + 1);
+
+            __m256d overlap = _mm256_and_pd(
+                _mm256_and_pd(lessEqualAvx2(minX, _mm256_max_pd(cx, dx)),
+                              lessEqualAvx2(_mm256_min_pd(cx, dx), maxX)),
+                _mm256_and_pd(lessEqualAvx2(minY, _mm256_max_pd(cy, dy)),
+                              lessEqualAvx2(_mm256_min_pd(cy, dy), maxY)));
+            int overlapBits = _mm256_movemask_pd(overlap);
+            if (overlapBits == 0) continue;
+
+            __m256d sure1, sure2, sure3, sure4;
+            __m256d o1 = orientAvx2(ax, ay, bx, by, cx, cy, sure1);
+            __m256d o2 = orientAvx2(ax, ay, bx, by, dx, dy, sure2);
+            __m256d o3 = orientAvx2(cx, cy, dx, dy, ax, ay, sure3);
+            __m256d o4 = orientAvx2(cx, cy, dx, dy, bx, by, sure4);
+            __m256d sure = _mm256_and_pd(_mm256_and_pd(sure1, sure2), _mm256_and_pd(sure3, sure4));
+            __m256d opposite = _mm256_and_pd(
+                _mm256_xor_pd(lessAvx2(o1, zero), lessAvx2(o2, zero)),
+                _mm256_xor_pd(lessAvx2(o3, zero), lessAvx2(o4, zero)));
+
+            if (_mm256_movemask_pd(_mm256_and_pd(_mm256_and_pd(overlap, sure), opposite)) != 0) {
+                crossing = true;
+                return;
+            }
+            int uncertainBits = overlapBits & ~_mm256_movemask_pd(sure);
+            for (int lane = 0; uncertainBits != 0; lane++, uncertainBits >>= 1) {
+                if (uncertainBits & 1) {
+                    scanEdgePair(i, other, j + lane, crossing, touching);
+                    if (crossing) return;
+                }
+            }
+        }
+        for (int j = vectorEnd; j < j1 && !crossing; j++) {
+            scanEdgePair(i, other, j, crossing, touching);
+        }
+    }
+}
+#endif
+
+// Mid-sized rings: every edge pair is tested, tile by tile, by the vector
+// kernel, which needs no index to be built first. Sets crossing when some edge
+// pair crosses, stopping there, and otherwise touching when some pair touches.
+void Polygon::scanEdgesTiled(const Polygon& other, bool& crossing, bool& touching) const {
+    int n = ring.size();
+    int m = other.ring.size();
+#ifdef POLYGON_X86_KERNELS
+    bool avx2 = activeBatchKernel() == BatchKernel::AVX2;
+#endif
+    for (int i0 = 0; i0 < n && !crossing; i0 += TILE_EDGES) {
+        int i1 = std::min(n, i0 + TILE_EDGES);
+        for (int j0 = 0; j0 < m && !crossing; j0 += TILE_EDGES) {
+            int j1 = std::min(m, j0 + TILE_EDGES);
+#ifdef POLYGON_X86_KERNELS
+            if (avx2) {
+                scanEdgeTileAvx2(i0, i1, other, j0, j1, crossing, touching);
+                continue;
+            }
+#endif
+            scanEdgeTileScalar(i0, i1, other, j0, j1, crossing, touching);
+        }
+    }
+}
+
+// Uniform grid over a polygon's bounding box for point-in-polygon queries. Cells
+// no edge comes near are wholly inside or outside and answer in O(1). Boundary
+// cells keep their candidate edges plus the parity of a probe point, and decide
+// a query by counting candidate edges crossed on the way from the probe.
+//
+// Answers match Polygon::contains. Probe rows avoid every vertex y, and a probe
+// segment that passes exactly through a vertex hands the query to the full
+// ray-cast instead.
+class PolygonGrid {
+public:
+    enum CellState : unsigned char { OUTSIDE, INSIDE, BOUNDARY, UNRESOLVED };
+
+    explicit PolygonGrid(const Polygon& polygon, int cellsPerSide = 0)
+        : vertices(polygon.vertices()), edges(batchEdges(polygon.vertices())) {
+        int n = vertices.size();
+        side = cellsPerSide > 0 ? cellsPerSide
+                                : std::max(1, (int)std::ceil(std::sqrt(2.0 * n)));
+
+        BoundingBox bounds(vertices);
+        double span = std::max(bounds.maxX - bounds.minX, bounds.maxY - bounds.minY);
+        margin = span * 1e-9;
+        extent = BoundingBox(bounds.minX - margin, bounds.minY - margin,
+                             bounds.maxX + margin, bounds.maxY + margin);
+        cellWidth = (extent.maxX - extent.minX) / side;
+        cellHeight = (extent.maxY - extent.minY) / side;
+
+        for (const auto& v : vertices) {
+            vertexYs.push_back(v.y);
+        }
+        std::sort(vertexYs.begin(), vertexYs.end());
+
+        buildCells();
+        resolveProbes();
+    }
+
+    CellState state(const Point& p) const {
+        int col, row;
+        if (!locate(p, col, row)) return OUTSIDE;
+        return cells[row * side + col].state;
+    }
+
+    bool contains(const Point& p) const {
+        int col, row;
+        if (!locate(p, col, row)) {
+            return false;
+        }
+
+        const Cell& cell = cells[row * side + col];
+        switch (cell.state) {
+        case INSIDE:
+            return true;
+        case OUTSIDE:
+            return false;
+        case UNRESOLVED:
+            return containsScalar(edges, p.x, p.y);
+        case BOUNDARY:
+            break;
+        }
+
+        for (int k = cell.first; k < cell.first + cell.count; k++) {
+            if (onEdge(edges[candidates[k]], p)) {
+                return true;
+            }
+        }
+
+        Point probe = probeOf(col, row);
+        bool parity = cell.probeInside;
+        for (int k = cell.first; k < cell.first + cell.count; k++) {
+            int i = candidates[k];
+            int crossing = crosses(vertices[i], vertices[(i + 1) % vertices.size()], probe, p);
+            if (crossing < 0) {
+                return containsScalar(edges, p.x, p.y);
+            }
+            parity ^= crossing == 1;
+        }
+        return parity;
+    }
+
+private:
+    struct Cell {
+        CellState state;
+        bool probeInside;
+        int first;
+        int count;
+    };
+
+    std::vector<Point> vertices;
+    std::vector<BatchEdge> edges;
+    std::vector<Cell> cells;
+    std::vector<int> candidates;
+    std::vector<double> probeYs;
+    std::vector<double> vertexYs;
+    BoundingBox extent;
+    double cellWidth, cellHeight, margin;
+    int side;
+
+    bool locate(const Point& p, int& col, int& row) const {
+        if (!extent.contains(p)) return false;
+        col = cellWidth > 0 ? std::min(side - 1, (int)((p.x - extent.minX) / cellWidth)) : 0;
+        row = cellHeight > 0 ? std::min(side - 1, (int)((p.y - extent.minY) / cellHeight)) : 0;
+        return true;
+    }
+
+    void cellRange(double lo, double hi, double origin, double size, int& first, int& last) const {
+        if (!(size > 0)) {
+            first = 0;
+            last = side - 1;
+            return;
+        }
+        first = std::max(0, std::min(side - 1, (int)std::floor((lo - origin) / size)));
+        last = std::max(0, std::min(side - 1, (int)std::floor((hi - origin) / size)));
+    }
+
+    void buildCells() {
+        cells.assign(side * side, Cell{OUTSIDE, false, 0, 0});
+
+        for (int pass = 0; pass < 2; pass++) {
+            for (int i = 0; i < (int)edges.size(); i++) {
+                const BatchEdge& e = edges[i];
+                int col1, col2, row1, row2;
+                cellRange(e.minX - margin, e.maxX + margin, extent.minX, cellWidth, col1, col2);
+                cellRange(e.minY - margin, e.maxY + margin, extent.minY, cellHeight, row1, row2);
+                for (int row = row1; row <= row2; row++) {
+                    for (int col = col1; col <= col2; col++) {
+                        Cell& cell = cells[row * side + col];
+                        if (pass == 0) {
+                            cell.count++;
+                        } else {
+                            candidates[cell.first + cell.count++] = i;
+                        }
+                    }
+                }
+            }
+
+            if (pass == 0) {
+                int offset = 0;
+                for (auto& cell : cells) {
+                    cell.first = offset;
+                    offset += cell.count;
+                    cell.state = cell.count > 0 ? BOUNDARY : OUTSIDE;
+                    cell.count = 0;
+                }
+                candidates.resize(offset);
+            }
+        }
+    }
+
+    // Picks one probe y per row away from every degenerate y, casts a ray along it
+    // and records the parity of each cell's probe point.
+    void resolveProbes() {
+        std::vector<std::vector<int>> rowEdges(side);
+        for (int i = 0; i < (int)edges.size(); i++) {
+            int row1, row2;
+            cellRange(edges[i].minY, edges[i].maxY, extent.minY, cellHeight, row1, row2);
+            for (int row = row1; row <= row2; row++) {
+                rowEdges[row].push_back(i);
+            }
+        }
+
+        probeYs.assign(side, 0);
+        const double fractions[] = {0.5, 0.375, 0.625, 0.25, 0.75, 0.125, 0.875};
+
+        for (int row = 0; row < side; row++) {
+            double probeY = 0;
+            bool found = false;
+            for (double f : fractions) {
+                probeY = extent.minY + (row + f) * cellHeight;
+                if (!degenerateY(probeY)) {
+                    found = true;
+                    break;
+                }
+            }
+            probeYs[row] = probeY;
+            if (!found) {
+                for (int col = 0; col < side; col++) {
+                    cells[row * side + col].state = UNRESOLVED;
+                }
+                continue;
+            }
+
+            std::vector<double> crossings;
+            for (int i : rowEdges[row]) {
+                const BatchEdge& e = edges[i];
+                if ((e.y1 > probeY) == (e.y2 > probeY)) continue;
+                crossings.push_back((probeY - e.y1) * (e.x2 - e.x1) / (e.y2 - e.y1) + e.x1);
+            }
+            std::sort(crossings.begin(), crossings.end());
+
+            for (int col = 0; col < side; col++) {
+                Cell& cell = cells[row * side + col];
+                double probeX = probeOf(col, row).x;
+                auto right = std::upper_bound(crossings.begin(), crossings.end(), probeX);
+                bool clear = (right == crossings.end() || *right - probeX > margin) &&
+                             (right == crossings.begin() || probeX - *(right - 1) > margin);
+
+                if (!clear) {
+                    cell.state = UNRESOLVED;
+                    continue;
+                }
+                cell.probeInside = (crossings.end() - right) % 2 == 1;
+                if (cell.state == OUTSIDE && cell.probeInside) {
+                    cell.state = INSIDE;
+                }
+            }
+        }
+    }
+
+    Point probeOf(int col, int row) const {
+        return Point(extent.minX + (col + 0.5) * cellWidth, probeYs[row]);
+    }
+
+    bool degenerateY(double y) const {
+        return std::binary_search(vertexYs.begin(), vertexYs.end(), y);
+    }
+
+    // The boundary test of Polygon::contains for a single edge.
+    static bool onEdge(const BatchEdge& e, const Point& p) {
+        return e.minX <= p.x && p.x <= e.maxX && e.minY <= p.y && p.y <= e.maxY &&
+               orient2d(e.x1, e.y1, e.x2, e.y2, p.x, p.y) == 0;
+    }
+
+    static int orientation(const Point& a, const Point& b, const Point& c) {
+        double det = orient2d(a, b, c);
+        return det > 0 ? 1 : (det < 0 ? -1 : 0);
+    }
+
+    // 1 if segment a-b properly crosses segment p-q, 0 if it misses, -1 if an
+    // endpoint of one lies exactly on the line of the other.
+    static int crosses(const Point& a, const Point& b, const Point& p, const Point& q) {
+        int o1 = orientation(a, b, p);
+        int o2 = orientation(a, b, q);
+        int o3 = orientation(p, q, a);
+        int o4 = orientation(p, q, b);
+        if (o1 == 0 || o2 == 0 || o3 == 0 || o4 == 0) {
+            bool apart = std::max(a.x, b.x) < std::min(p.x, q.x) ||
+                         std::max(p.x, q.x) < std::min(a.x, b.x) ||
+                         std::max(a.y, b.y) < std::min(p.y, q.y) ||
+                         std::max(p.y, q.y) < std::min(a.y, b.y);
+            return apart ? 0 : -1;
+        }
+        return (o1 != o2 && o3 != o4) ? 1 : 0;
+    }
+};
+
+// Static R-tree over polygon bounding boxes, bulk-loaded with Sort-Tile-Recursive
+// packing. Queries report indices into the collection the tree was built from.
+class RTree {
+public:
+    explicit RTree(const std::vector<Polygon>& polygons, int nodeCapacity = 16)
+        : RTree(boundsOf(polygons), nodeCapacity) {}
+
+    explicit RTree(std::vector<BoundingBox> itemBounds, int nodeCapacity = 16)
+        : boxes(std::move(itemBounds)), capacity(std::max(2, nodeCapacity)), root(-1) {
+        if (boxes.empty()) {
+            return;
+        }
+
+        std::vector<int> level;
+        std::vector<Entry> entries;
+        for (int i = 0; i < (int)boxes.size(); i++) {
+            entries.push_back({boxes[i], i});
+        }
+        bool leaf = true;
+
+        while (true) {
+            level.clear();
+            for (const auto& group : pack(entries)) {
+                Node node;
+                node.first = links.size();
+                node.count = group.size();
+                node.leaf = leaf;
+                for (const auto& entry : group) {
+                    node.bounds.expand(Point(entry.bounds.minX, entry.bounds.minY));
+                    node.bounds.expand(Point(entry.bounds.maxX, entry.bounds.maxY));
+                    links.push_back(entry.id);
+                }
+                level.push_back(nodes.size());
+                nodes.push_back(node);
+            }
+
+            if (level.size() == 1) {
+                break;
+            }
+
+            entries.clear();
+            for (int id : level) {
+                entries.push_back({nodes[id].bounds, id});
+            }
+            leaf = false;
+        }
+        root = level[0];
+    }
+
+    std::size_t size() const {
+        return boxes.size();
+    }
+
+    // Calls visit(index) for every item whose box intersects window. Stops early
+    // and returns false if visit returns false.
+    template <typename Visitor>
+    bool query(const BoundingBox& window, Visitor visit) const {
+        if (root < 0) {
+            return true;
+        }
+
+        std::vector<int> stack(1, root);
+        while (!stack.empty()) {
+            const Node& node = nodes[stack.back()];
+            stack.pop_back();
+            if (!node.bounds.intersects(window)) continue;
+
+            for (int k = node.first; k < node.first + node.count; k++) {
+                int child = links[k];
+                if (!node.leaf) {
+                    stack.push_back(child);
+                } else if (boxes[child].intersects(window) && !visit(child)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    std::vector<int> query(const BoundingBox& window) const {
+        std::vector<int> result;
+        query(window, [&](int index) {
+            result.push_back(index);
+            return true;
+        });
+        return result;
+    }
+
+    std::vector<int> query(const Point& p) const {
+        return query(BoundingBox(p.x, p.y, p.x, p.y));
+    }
+
+    std::vector<int> candidates(const Polygon& polygon) const {
+        return query(polygon.bounds());
+    }
+
+private:
+    struct Node {
+        BoundingBox bounds;
+        int first;
+        int count;
+        bool leaf;
+    };
+
+    struct Entry {
+        BoundingBox bounds;
+        int id;
+    };
+
+    std::vector<BoundingBox> boxes;
+    std::vector<Node> nodes;
+    std::vector<int> links;
+    int capacity;
+    int root;
+
+    static std::vector<BoundingBox> boundsOf(const std::vector<Polygon>& polygons) {
+        std::vector<BoundingBox> result;
+        result.reserve(polygons.size());
+        for (const auto& polygon : polygons) {
+            result.push_back(polygon.bounds());
+        }
+        return result;
+    }
+
+    // Sorts entries into vertical slices by center x, then each slice by center y,
+    // and cuts the result into runs of at most capacity entries.
+    std::vector<std::vector<Entry>> pack(std::vector<Entry>& entries) const {
+        auto centerX = [](const Entry& e) { return e.bounds.minX + e.bounds.maxX; };
+        auto centerY = [](const Entry& e) { return e.bounds.minY + e.bounds.maxY; };
+
+        int count = entries.size();
+        int pages = (count + capacity - 1) / capacity;
+        int slices = std::ceil(std::sqrt((double)pages));
+        int sliceSize = slices * capacity;
+
+        std::sort(entries.begin(), entries.end(), [&](const Entry& e1, const Entry& e2) {
+            return centerX(e1) < centerX(e2);
+        });
+
+        std::vector<std::vector<Entry>> groups;
+        for (int start = 0; start < count; start += sliceSize) {
+            auto first = entries.begin() + start;
+            auto last = entries.begin() + std::min(count, start + sliceSize);
+            std::sort(first, last, [&](const Entry& e1, const Entry& e2) {
+                return centerY(e1) < centerY(e2);
+            });
+            for (auto it = first; it < last; it += std::min<std::ptrdiff_t>(capacity, last - it)) {
+                groups.emplace_back(it, it + std::min<std::ptrdiff_t>(capacity, last - it));
+            }
+        }
+        return groups;
+    }
+};
+
+// Fixed-size pool where each worker owns a task deque. Workers pop their own
+// newest task first and steal the oldest task from another worker when idle.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency())
+        : queued(0), pending(0), stopping(false), nextQueue(0) {
+        threads = std::max(1u, threads);
+        for (unsigned i = 0; i < threads; i++) {
+            queues.emplace_back(new Queue);
+        }
+        for (unsigned i = 0; i < threads; i++) {
+            workers.emplace_back(&ThreadPool::run, this, i);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const {
+        return workers.size();
+    }
+
+    // Whether the calling thread is one of this pool's workers.
+    bool onWorker() const {
+        return currentWorker().first == this;
+    }
+
+    // Tasks submitted from a worker go to that worker's own deque.
+    void submit(std::function<void()> task) {
+        unsigned index = onWorker() ? currentWorker().second : nextQueue++ % queues.size();
+        pending++;
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            queued++;
+        }
+        wake.notify_one();
+    }
+
+    // Blocks until every submitted task has finished and rethrows the first
+    // exception a task raised, if any. Must not be called from a task of this
+    // pool: the calling task is itself unfinished, so the wait never ends.
+    void wait() {
+        assert(!onWorker() && "ThreadPool::wait called from one of its own tasks");
+        std::unique_lock<std::mutex> lock(stateMutex);
+        idle.wait(lock, [this] { return pending == 0; });
+        if (failure) {
+            std::exception_ptr error = failure;
+            failure = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex stateMutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::size_t queued;
+    std::atomic<std::size_t> pending;
+    std::exception_ptr failure;
+    bool stopping;
+    std::atomic<unsigned> nextQueue;
+
+    static std::pair<const ThreadPool*, unsigned>& currentWorker() {
+        static thread_local std::pair<const ThreadPool*, unsigned> worker(nullptr, 0);
+        return worker;
+    }
+
+    bool take(unsigned index, std::function<void()>& task) {
+        for (unsigned k = 0; k < queues.size(); k++) {
+            Queue& queue = *queues[(index + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+            if (k == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void run(unsigned index) {
+        currentWorker() = std::make_pair(this, index);
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(stateMutex);
+                wake.wait(lock, [this] { return stopping || queued > 0; });
+                if (stopping && queued == 0) return;
+                queued--;
+            }
+
+            std::function<void()> task;
+            while (!take(index, task)) {
+                std::this_thread::yield();
+            }
+
+            try {
+                task();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                if (!failure) failure = std::current_exception();
+            }
+
+            if (--pending == 0) {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                idle.notify_all();
+            }
+        }
+    }
+};
+
+// 32-bit Morton key of a box center within extent, used to give each join task a
+// spatially coherent run of polygons.
+std::uint32_t mortonKey(const BoundingBox& box, const BoundingBox& extent) {
+    auto cell = [](double v, double lo, double hi) -> std::uint32_t {
+        if (!(hi > lo)) return 0;
+        double t = (v - lo) / (hi - lo);
+        return (std::uint32_t)(std::max(0.0, std::min(1.0, t)) * 65535);
+    };
+    auto spread = [](std::uint32_t v) {
+        v = (v | (v << 8)) & 0x00FF00FF;
+        v = (v | (v << 4)) & 0x0F0F0F0F;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    };
+    std::uint32_t x = cell((box.minX + box.maxX) / 2, extent.minX, extent.maxX);
+    std::uint32_t y = cell((box.minY + box.maxY) / 2, extent.minY, extent.maxY);
+    return spread(x) | (spread(y) << 1);
+}
+
+// The chunked join behind spatialJoin and selfJoin. The right set is indexed
+// with an RTree and the left set is split into Morton-ordered chunks that run
+// on pool. Every left/right pair whose bounding boxes overlap and that accept
+// lets through is classified, and interacting pairs go to
+// emit(leftIndex, rightIndex, relationship). Each task buffers at most
+// resultBatch results before handing them to emit, which is called under a
+// lock and need not be thread-safe. Returns the number of pairs emitted. Like
+// ThreadPool::wait, which it ends with, it must not be called from a pool task.
+template <typename Accept, typename Emit>
+std::size_t indexedJoin(const std::vector<Polygon>& left, const std::vector<Polygon>& right,
+                        Accept accept, Emit emit, ThreadPool& pool, std::size_t chunkSize) {
+    const std::size_t resultBatch = 4096;
+
+    RTree index(right);
+
+    BoundingBox extent;
+    for (const auto& polygon : right) {
+        extent.expand(Point(polygon.bounds().minX, polygon.bounds().minY));
+        extent.expand(Point(polygon.bounds().maxX, polygon.bounds().maxY));
+    }
+
+    std::vector<std::pair<std::uint32_t, int>> order;
+    order.reserve(left.size());
+    for (int i = 0; i < (int)left.size(); i++) {
+        order.emplace_back(mortonKey(left[i].bounds(), extent), i);
+    }
+    std::sort(order.begin(), order.end());
+
+    std::mutex emitMutex;
+    std::atomic<std::size_t> emitted(0);
+
+    struct Match {
+        int leftIndex;
+        int rightIndex;
+        Relationship relationship;
+    };
+
+    chunkSize = std::max<std::size_t>(1, chunkSize);
+    for (std::size_t start = 0; start < order.size(); start += chunkSize) {
+        std::size_t end = std::min(order.size(), start + chunkSize);
+        pool.submit([&, start, end] {
+            std::vector<Match> buffer;
+            auto flush = [&] {
+                if (buffer.empty()) return;
+                std::lock_guard<std::mutex> lock(emitMutex);
+                for (const auto& match : buffer) {
+                    emit(match.leftIndex, match.rightIndex, match.relationship);
+                }
+                emitted += buffer.size();
+                buffer.clear();
+            };
+
+            for (std::size_t k = start; k < end; k++) {
+                int i = order[k].second;
+                index.query(left[i].bounds(), [&](int j) {
+                    if (!accept(i, j)) return true;
+                    Relationship relationship = left[i].classifyExact(right[j]);
+                    if (relationship != Relationship::OUTSIDE) {
+                        buffer.push_back({i, j, relationship});
+                        if (buffer.size() >= resultBatch) flush();
+                    }
+                    return true;
+                });
+            }
+            flush();
+        });
+    }
+    pool.wait();
+
+    return emitted;
+}
+
+// Classifies every left/right pair whose bounding boxes overlap and reports the
+// interacting ones through emit(leftIndex, rightIndex, relationship), as
+// described for indexedJoin.
+template <typename Emit>
+std::size_t spatialJoin(const std::vector<Polygon>& left, const std::vector<Polygon>& right,
+                        Emit emit, ThreadPool& pool, std::size_t chunkSize = 1024) {
+    return indexedJoin(left, right, [](int, int) { return true; }, emit, pool, chunkSize);
+}
+
+template <typename Emit>
+std::size_t spatialJoin(const std::vector<Polygon>& left, const std::vector<Polygon>& right,
+                        Emit emit) {
+    ThreadPool pool;
+    return spatialJoin(left, right, emit, pool);
+}
+
+// Every interacting pair within one set, for checking the topology of a single
+// layer, reported as emit(i, j, relationship) with i < j. The set is joined
+// with itself through indexedJoin. The tree still meets each overlapping pair
+// from both ends, but only the visit from the lower index classifies it, and a
+// polygon is never classified against itself.
+template <typename Emit>
+std::size_t selfJoin(const std::vector<Polygon>& polygons, Emit emit, ThreadPool& pool,
+                     std::size_t chunkSize = 1024) {
+    return indexedJoin(polygons, polygons, [](int i, int j) { return i < j; }, emit, pool,
+                       chunkSize);
+}
+
+template <typename Emit>
+std::size_t selfJoin(const std::vector<Polygon>& polygons, Emit emit) {
+    ThreadPool pool;
+    return selfJoin(polygons, emit, pool);
+}
+
+// Greedy non-maximum suppression. Visits polygons by descending score and keeps
+// each one that no already kept polygon overlaps with intersection over union
+// above iouThreshold. Overlapping pairs are found through an RTree on the
+// bounds and their areas are computed in chunks of chunkSize on pool, so only
+// box-overlapping pairs are clipped; the greedy pass that follows is sequential.
+// Returns the kept indices in score order.
+std::vector<int> nonMaximumSuppression(const std::vector<Polygon>& polygons,
+                                       const std::vector<double>& scores, double iouThreshold,
+                                       ThreadPool& pool, std::size_t chunkSize = 256) {
+    int n = polygons.size();
+    std::vector<int> order(n), rank(n);
+    for (int i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](int i, int j) { return scores[i] > scores[j]; });
+    for (int r = 0; r < n; r++) {
+        rank[order[r]] = r;
+    }
+
+    std::vector<double> areas(n);
+    for (int i = 0; i < n; i++) {
+        areas[i] = polygons[i].area();
+    }
+
+    RTree index(polygons);
+    std::vector<std::vector<int>> suppresses(n);
+
+    chunkSize = std::max<std::size_t>(1, chunkSize);
+    for (std::size_t start = 0; start < (std::size_t)n; start += chunkSize) {
+        std::size_t end = std::min<std::size_t>(n, start + chunkSize);
+        pool.submit([&, start, end] {
+            for (std::size_t r = start; r < end; r++) {
+                int i = order[r];
+                index.query(polygons[i].bounds(), [&](int j) {
+                    if (rank[j] > (int)r) {
+                        double shared = polygons[i].intersectionArea(polygons[j]);
+                        double combined = areas[i] + areas[j] - shared;
+                        if (combined > 0 && shared / combined > iouThreshold) {
+                            suppresses[r].push_back(rank[j]);
+                        }
+                    }
+                    return true;
+                });
+            }
+        });
+    }
+    pool.wait();
+
+    std::vector<int> kept;
+    std::vector<bool> suppressed(n, false);
+    for (int r = 0; r < n; r++) {
+        if (suppressed[r]) continue;
+        kept.push_back(order[r]);
+        for (int later : suppresses[r]) {
+            suppressed[later] = true;
+        }
+    }
+    return kept;
+}
+
+std::vector<int> nonMaximumSuppression(const std::vector<Polygon>& polygons,
+                                       const std::vector<double>& scores, double iouThreshold) {
+    ThreadPool pool;
+    return nonMaximumSuppression(polygons, scores, iouThreshold, pool);
+}
+
+// Intersection over union of query with every polygon, written to ious. Pairs
+// whose bounds are disjoint get 0 without clipping.
+void intersectionOverUnionBatch(const Polygon& query, const std::vector<Polygon>& polygons,
+                                double* ious) {
+    double queryArea = query.area();
+    for (std::size_t i = 0; i < polygons.size(); i++) {
+        ious[i] = 0;
+        if (!query.bounds().intersects(polygons[i].bounds())) continue;
+        double shared = query.intersectionArea(polygons[i]);
+        double combined = queryArea + polygons[i].area() - shared;
+        ious[i] = combined > 0 ? shared / combined : 0;
+    }
+}
+
+// classify for a pair with at least one huge polygon, spread over pool. The
+// edge hierarchy of the larger polygon is cut into subtrees, several per
+// worker, and each task walks its subtree against the whole hierarchy of the
+// other. Tasks share atomic crossing and touching flags, and all of them stop
+// once a crossing is found. Containment then needs one indexed point query per
+// side, which runs on the calling thread. Smaller pairs just run classify, and
+// so does a call from one of pool's own tasks, which could not wait on pool.
+Relationship classifyParallel(const Polygon& polygon, const Polygon& other, ThreadPool& pool) {
+    std::size_t n = polygon.vertices().size();
+    std::size_t m = other.vertices().size();
+    if (std::max(n, m) < HIERARCHY_THRESHOLD || std::min(n, m) == 0 || pool.onWorker()) {
+        return polygon.classify(other);
+    }
+    if (classifyFilters().rejects(polygon, other)) {
+        return Relationship::OUTSIDE;
+    }
+
+    bool splitOther = m > n;
+    const EdgeHierarchy& tree = (splitOther ? other : polygon).edgeHierarchy();
+    std::vector<int> subtrees(1, tree.root());
+    std::size_t wanted = 8 * pool.size();
+    while (subtrees.size() < wanted) {
+        std::vector<int> next;
+        for (int node : subtrees) {
+            const EdgeHierarchy::Node& n = tree.nodes[node];
+            if (n.children == 0) {
+                next.push_back(node);
+            }
+            for (int k = n.child; k < n.child + n.children; k++) {
+                next.push_back(k);
+            }
+        }
+        if (next.size() == subtrees.size()) break;
+        subtrees.swap(next);
+    }
+
+    std::atomic<bool> crossing(false);
+    std::atomic<bool> touching(false);
+    int root1 = polygon.edgeHierarchy().root();
+    int root2 = other.edgeHierarchy().root();
+    for (int node : subtrees) {
+        pool.submit([&, node] {
+            int node1 = splitOther ? root1 : node;
+            int node2 = splitOther ? node : root2;
+            polygon.visitEdgePairs(other, node1, node2, [&](int i, int j) {
+                if (crossing.load(std::memory_order_relaxed)) {
+                    return false;
+                }
+                if (polygon.edgesCross(i, other, j)) {
+                    crossing.store(true, std::memory_order_relaxed);
+                    return false;
+                }
+                if (!touching.load(std::memory_order_relaxed) && polygon.edgesTouch(i, other, j)) {
+                    touching.store(true, std::memory_order_relaxed);
+                }
+                return true;
+            });
+        });
+    }
+    pool.wait();
+
+    if (crossing) {
+        return Relationship::INTERSECTING;
+    }
+    if (touching) {
+        return Relationship::TOUCHING;
+    }
+
+    return polygon.classifyContainment(other);
+}
+
+#ifndef POLYGON_NO_MAIN
 int main() {
     Polygon polygon1({Point(4, 4), Point(4, -4), Point(-4, -4), Point(-4, 4)});
     Polygon polygon2({Point(2, 2), Point(2, -2), Point(-2, -2), Point(2, -2)});
@@ -251,8 +4032,9 @@ int main() {
     polygon1.print();
     polygon2.print();
 
-    std::string relationship = polygon1.classify(polygon2);
-    std::cout << "Relationship: " << relationship << "\n";
+    Relationship relationship = polygon1.classify(polygon2);
+    std::cout << "Relationship: " << relationshipLabel(relationship) << "\n";
 
     return 0;
 }
+#endif
@@ -0,0 +1,39 @@
+// Self-checks for polygon.c, run by `make check`. Prints every failure and
+// exits non-zero if there was one.
+#define POLYGON_NO_MAIN
+#include "polygon.c"
+
+int failures = 0;
+
+void check(bool ok, const char* what) {
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+int main() {
+    // A ray from the triangle's first vertex passes through a vertex of the
+    // square; counting that vertex twice reported the triangle as enclosed.
+    Point triangleVertices[] = {{0, 0}, {4, 2}, {4, -2}};
+    Point squareVertices[] = {{-5, 0}, {-6, 1}, {-7, 0}, {-6, -1}};
+    Polygon triangle = {triangleVertices, 3};
+    Polygon square = {squareVertices, 4};
+    check(classifyPolygons(&triangle, &square) == OUTSIDE, "triangle against square");
+    check(classifyPolygons(&square, &triangle) == OUTSIDE, "square against triangle");
+
+    // Nested rings with disjoint boundaries.
+    Point outerVertices[] = {{-4, -4}, {4, -4}, {4, 4}, {-4, 4}};
+    Point innerVertices[] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+    Polygon outer = {outerVertices, 4};
+    Polygon inner = {innerVertices, 4};
+    check(classifyPolygons(&outer, &inner) == ENCLOSED, "outer against inner");
+    check(classifyPolygons(&inner, &outer) == ENCLOSED, "inner against outer");
+
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,191 @@
+// Self-checks for polygon.cpp, run by `make check`. Each check compares a fast
+// path against the plain answer it claims to match, or pins a case that once
+// came out wrong. Prints every failure and exits non-zero if there was one.
+#define POLYGON_NO_MAIN
+#include "polygon.cpp"
+
+#include <random>
+#include <set>
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cout << "FAIL: " << what << "\n";
+        failures++;
+    }
+}
+
+// Star-shaped ring around (cx, cy) on the integer grid, so that vertices and
+// edge midpoints make exact boundary points.
+std::vector<Point> randomRing(std::mt19937& rng, int n, double cx, double cy, double radius) {
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::vector<double> angles(n);
+    for (auto& angle : angles) {
+        angle = unit(rng) * 2 * M_PI;
+    }
+    std::sort(angles.begin(), angles.end());
+
+    std::vector<Point> ring;
+    for (double angle : angles) {
+        double r = radius * (0.3 + 0.7 * unit(rng));
+        Point p(std::round(cx + r * std::cos(angle)), std::round(cy + r * std::sin(angle)));
+        if (ring.empty() || p.x != ring.back().x || p.y != ring.back().y) {
+            ring.push_back(p);
+        }
+    }
+    while (ring.size() > 1 && ring.front().x == ring.back().x && ring.front().y == ring.back().y) {
+        ring.pop_back();
+    }
+    return ring;
+}
+
+std::vector<BatchKernel> availableKernels() {
+    std::vector<BatchKernel> kernels(1, BatchKernel::SCALAR);
+#ifdef POLYGON_X86_KERNELS
+    if (__builtin_cpu_supports("sse2")) kernels.push_back(BatchKernel::SSE2);
+    if (__builtin_cpu_supports("avx2")) kernels.push_back(BatchKernel::AVX2);
+#endif
+    return kernels;
+}
+
+// Every batch kernel the CPU runs must set exactly the bits contains() reports,
+// including for points on vertices and edges.
+void checkBatchContains(std::mt19937& rng) {
+    std::uniform_real_distribution<double> unit(0, 1);
+    for (int round = 0; round < 50; round++) {
+        Polygon polygon(randomRing(rng, 3 + round % 40, 0, 0, 50));
+        const std::vector<Point>& ring = polygon.vertices();
+
+        std::vector<double> xs, ys;
+        for (int i = 0; i < (int)ring.size(); i++) {
+            const Point& next = ring[(i + 1) % ring.size()];
+            xs.push_back(ring[i].x);
+            ys.push_back(ring[i].y);
+            xs.push_back((ring[i].x + next.x) / 2);
+            ys.push_back((ring[i].y + next.y) / 2);
+        }
+        for (int k = 0; k < 500; k++) {
+            xs.push_back(std::round(unit(rng) * 120 - 60));
+            ys.push_back(unit(rng) < 0.5 ? std::round(unit(rng) * 120 - 60) : unit(rng) * 120 - 60);
+        }
+
+        std::vector<BatchEdge> edges = batchEdges(ring);
+        std::vector<std::uint64_t> mask((xs.size() + 63) / 64);
+        for (BatchKernel kernel : availableKernels()) {
+            containsBatch(edges, xs.data(), ys.data(), xs.size(), mask.data(), kernel);
+            int mismatches = 0;
+            for (std::size_t i = 0; i < xs.size(); i++) {
+                bool inside = (mask[i / 64] >> (i % 64)) & 1;
+                mismatches += inside != polygon.contains(Point(xs[i], ys[i]));
+            }
+            check(mismatches == 0, "containsBatch kernel " + std::to_string(int(kernel)) +
+                                       " disagrees with contains on " +
+                                       std::to_string(mismatches) + " points");
+        }
+    }
+}
+
+// A prepared ring must classify every candidate as the plain ring does.
+void checkPrepared(std::mt19937& rng) {
+    std::uniform_real_distribution<double> unit(0, 1);
+    int mismatches = 0;
+    for (int round = 0; round < 200; round++) {
+        Polygon polygon(randomRing(rng, 3 + round % 60, 0, 0, 40));
+        PreparedPolygon prepared(polygon);
+        for (int k = 0; k < 20; k++) {
+            Polygon other(randomRing(rng, 3 + k % 9, unit(rng) * 80 - 40, unit(rng) * 80 - 40,
+                                     2 + unit(rng) * 30));
+            Relationship expected = polygon.classify(other);
+            mismatches += prepared.classify(other) != expected;
+            mismatches += prepared.classify(PreparedPolygon(other)) != expected;
+        }
+    }
+    check(mismatches == 0, "PreparedPolygon::classify disagrees with Polygon::classify on " +
+                               std::to_string(mismatches) + " pairs");
+}
+
+// spatialJoin and selfJoin must report exactly the interacting pairs found by
+// classifying every pair.
+void checkJoins(std::mt19937& rng) {
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::vector<Polygon> left, right;
+    for (int k = 0; k < 300; k++) {
+        left.emplace_back(
+            randomRing(rng, 3 + k % 12, unit(rng) * 400, unit(rng) * 400, 5 + unit(rng) * 20));
+        right.emplace_back(
+            randomRing(rng, 3 + k % 7, unit(rng) * 400, unit(rng) * 400, 5 + unit(rng) * 20));
+    }
+
+    typedef std::set<std::tuple<int, int, Relationship>> Matches;
+    Matches joined, expected;
+    ThreadPool pool(4);
+    spatialJoin(left, right, [&](int i, int j, Relationship relationship) {
+        joined.insert(std::make_tuple(i, j, relationship));
+    }, pool, 16);
+    for (int i = 0; i < (int)left.size(); i++) {
+        for (int j = 0; j < (int)right.size(); j++) {
+            Relationship relationship = left[i].classify(right[j]);
+            if (relationship != Relationship::OUTSIDE) {
+                expected.insert(std::make_tuple(i, j, relationship));
+            }
+        }
+    }
+    check(joined == expected, "spatialJoin disagrees with the pairwise classify");
+
+    joined.clear();
+    expected.clear();
+    selfJoin(left, [&](int i, int j, Relationship relationship) {
+        joined.insert(std::make_tuple(i, j, relationship));
+    }, pool, 16);
+    for (int i = 0; i < (int)left.size(); i++) {
+        for (int j = i + 1; j < (int)left.size(); j++) {
+            Relationship relationship = left[i].classify(left[j]);
+            if (relationship != Relationship::OUTSIDE) {
+                expected.insert(std::make_tuple(i, j, relationship));
+            }
+        }
+    }
+    check(joined == expected, "selfJoin disagrees with the pairwise classify");
+}
+
+// Pairs that once came out wrong.
+void checkCases() {
+    // A ray from the triangle's first vertex passes through a vertex of the
+    // square; counting that vertex twice reported the triangle as enclosed.
+    Polygon triangle({Point(0, 0), Point(4, 2), Point(4, -2)});
+    Polygon square({Point(-5, 0), Point(-6, 1), Point(-7, 0), Point(-6, -1)});
+    check(triangle.classify(square) == Relationship::OUTSIDE, "triangle against square");
+    check(square.classify(triangle) == Relationship::OUTSIDE, "square against triangle");
+
+    // Edge iterators must stay valid after the view they came from is gone.
+    EdgeView::iterator edge = triangle.edges().begin();
+    ++edge;
+    check((*edge).p2.x == 4 && (*edge).p2.y == -2, "edge iterator from a temporary view");
+
+    // Under open boundaries, rings that only touch are classified by whether
+    // their interiors meet.
+    typedef BasicPolygon<double, ExactTolerance, OpenBoundary> OpenPolygon;
+    OpenPolygon left({Point(0, 0), Point(10, 0), Point(10, 10), Point(0, 10)});
+    OpenPolygon middle({Point(5, 0), Point(15, 0), Point(15, 10), Point(5, 10)});
+    OpenPolygon right({Point(10, 0), Point(20, 0), Point(20, 10), Point(10, 10)});
+    check(left.classify(middle) == Relationship::INTERSECTING, "open overlapping squares");
+    check(middle.classify(left) == Relationship::INTERSECTING, "open overlapping squares, swapped");
+    check(left.classify(left) == Relationship::INTERSECTING, "open identical squares");
+    check(left.classify(right) == Relationship::OUTSIDE, "open squares sharing an edge");
+}
+
+int main() {
+    std::mt19937 rng(2024);
+    checkBatchContains(rng);
+    checkPrepared(rng);
+    checkJoins(rng);
+    checkCases();
+
+    if (failures > 0) {
+        std::cout << failures << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << "All checks passed\n";
+    return 0;
+}